@@ -5,6 +5,10 @@
 #include <csignal>      
 #include <memory>      
 #include <vector>       
+#include <functional>
+#include <fstream>
+#include <map>
+#include <stdexcept>
 
 #include <spdlog/spdlog.h>
 #include <unistd.h>     
@@ -15,7 +19,59 @@
 
 std::atomic<bool> g_client_running{true};
 
-void read_loop(int client_socket_fd) {
+// Files other users are sending us, by transfer id. Each is written as its chunks
+// arrive, to "received-<id>-<name>" in the working directory.
+struct IncomingFile {
+    std::ofstream out;
+    std::string path;
+};
+
+// Handles the server's file frames: "[FILE id size] user: name", "[CHUNK id] <bytes>"
+// and "[FILE id done]" / "[FILE id aborted]". Returns false for anything else.
+bool handle_file_frame(const std::string& msg, std::map<std::uint64_t, IncomingFile>& incoming) {
+    bool chunk = msg.rfind("[CHUNK ", 0) == 0;
+    if (!chunk && msg.rfind("[FILE ", 0) != 0) {
+        return false;
+    }
+    size_t close = msg.find(']');
+    if (close == std::string::npos) {
+        return false;
+    }
+    std::string head = msg.substr(1, close - 1);  // "CHUNK 7", "FILE 7 1234", "FILE 7 done"
+    size_t id_start = head.find(' ') + 1;
+    size_t id_end = head.find(' ', id_start);
+    std::uint64_t id = std::strtoull(head.c_str() + id_start, nullptr, 10);
+    std::string rest = id_end == std::string::npos ? "" : head.substr(id_end + 1);
+    auto it = incoming.find(id);
+
+    if (chunk) {
+        if (it != incoming.end()) {
+            it->second.out.write(msg.data() + close + 2, msg.size() - std::min(msg.size(), close + 2));
+        }
+    } else if (rest == "done" || rest == "aborted") {
+        if (it != incoming.end()) {
+            std::cout << (rest == "done" ? "--- Saved " : "--- Transfer aborted, partial file ")
+                      << it->second.path << " ---" << std::endl;
+            incoming.erase(it);
+        }
+    } else {
+        // "user: name"; only the last path component of the name is trusted.
+        std::string from = msg.substr(std::min(msg.size(), close + 2));
+        std::string name = from.substr(from.find(": ") == std::string::npos ? 0 : from.find(": ") + 2);
+        name = name.substr(name.find_last_of('/') + 1);
+        IncomingFile file;
+        file.path = "received-" + std::to_string(id) + "-" + name;
+        file.out.open(file.path, std::ios::binary | std::ios::trunc);
+        std::cout << "--- " << from << " (" << rest << " bytes) -> " << file.path << " ---" << std::endl;
+        if (file.out) {
+            incoming[id] = std::move(file);
+        }
+    }
+    return true;
+}
+
+void read_loop(tt::chat::client::Client& client) {
+    int client_socket_fd = client.get_socket_fd();
     spdlog::info("Read loop started for FD {}", client_socket_fd);
     if (client_socket_fd < 0) {
         spdlog::error("Read loop received invalid socket FD. Terminating read loop.");
@@ -23,50 +79,24 @@ void read_loop(int client_socket_fd) {
         return;
     }
 
-    const int LENGTH_PREFIX_SIZE = 20;
-
+    std::string received_msg;
+    std::map<std::uint64_t, IncomingFile> incoming;
     while (g_client_running) {
-        char len_buf[LENGTH_PREFIX_SIZE + 1];
-        len_buf[LENGTH_PREFIX_SIZE] = '\0';
+        // Framing (v1 length prefix or v2 header) is handled by the client.
+        bool ok = client.receive_message(received_msg);
 
-        ssize_t n_len = recv(client_socket_fd, len_buf, LENGTH_PREFIX_SIZE, 0);
-
-        if (!g_client_running) { 
+        if (!g_client_running) {
             break;
         }
-        if (n_len <= 0) {
-            std::cout << "--- Server closed connection or read error on length ---" << std::endl;
-            if (n_len < 0) { 
-                std::cerr << "Read length error: " << strerror(errno) << std::endl;
-            }
+        if (!ok) {
+            std::cout << "--- Server closed connection or read error ---" << std::endl;
             g_client_running = false;
             break;
         }
 
-        int msg_len = atoi(len_buf);
-        if (msg_len <= 0) {
-            spdlog::warn("Received invalid message length from server: '{}'. Skipping message.", len_buf);
-            continue; 
+        if (!handle_file_frame(received_msg, incoming)) {
+            std::cout << received_msg << std::endl;
         }
-
-        std::vector<char> buffer(msg_len);
-
-        ssize_t n_msg = recv(client_socket_fd, buffer.data(), msg_len, 0);
-
-        if (!g_client_running) {
-            break;
-        }
-        if (n_msg <= 0) {
-            std::cout << "--- Server closed connection or read error on message body ---" << std::endl;
-            if (n_msg < 0) { 
-                std::cerr << "Read message body error: " << strerror(errno) << std::endl;
-            }
-            g_client_running = false; 
-            break;
-        }
-
-        std::string received_msg(buffer.data(), msg_len);
-        std::cout << received_msg << std::endl;
     }
     spdlog::info("Read loop terminated for FD {}", client_socket_fd);
 }
@@ -75,6 +105,8 @@ int main(int argc, char* argv[]) {
     // Basic command line argument parsing
     std::string server_ip = "127.0.0.1";
     int port = 8080;
+    int protocol = 1;
+    bool compress = false;
 
     if (argc > 1) {
         server_ip = argv[1];
@@ -86,6 +118,10 @@ int main(int argc, char* argv[]) {
             std::cerr << "Invalid port number: " << argv[2] << ". Using default " << port << std::endl;
         }
     }
+    if (argc > 3 && std::string(argv[3]) == "2") {
+        protocol = 2; // binary framing, negotiated right after connecting
+        compress = argc > 4 && std::string(argv[4]) == "deflate";
+    }
 
     spdlog::set_level(spdlog::level::info);
     spdlog::info("Command-line Chat Client starting to connect to {}:{}", server_ip, port);
@@ -93,6 +129,11 @@ int main(int argc, char* argv[]) {
     std::unique_ptr<tt::chat::client::Client> chat_client_ptr;
     try {
         chat_client_ptr = std::make_unique<tt::chat::client::Client>(port, server_ip);
+        if (protocol == 2 && !chat_client_ptr->negotiate_protocol_v2(compress)) {
+            spdlog::warn("Server does not support protocol 2, staying on protocol 1.");
+        } else if (compress && !chat_client_ptr->compressing()) {
+            spdlog::warn("Server declined compression.");
+        }
         std::cout << "Connected to server. Type messages or '/quit' to exit." << std::endl;
     } catch (const std::runtime_error& e) {
         spdlog::critical("Failed to create or connect client: {}", e.what());
@@ -106,7 +147,7 @@ int main(int argc, char* argv[]) {
 
 
     int client_socket_fd = chat_client_ptr->get_socket_fd();
-    std::thread reader_thread(read_loop, client_socket_fd);
+    std::thread reader_thread(read_loop, std::ref(*chat_client_ptr));
 
     std::string input_line;
     std::cout << "> " << std::flush; // Initial prompt
@@ -125,19 +166,40 @@ int main(int argc, char* argv[]) {
         if (input_line == "/help") {
             std::cout <<
                 "Available commands:\n"
-                "/list                - List available channels\n"
-                "/create <name>       - Create a new channel\n"
-                "/join <name>         - Join a channel\n"
-                "/users               - List users in current channel\n"
-                "/dm @user <message>  - Send a private message\n"
-                "/sendfile <filename> - Upload file\n"
-                "/help                - Show this help message\n"
-                "/message <message>   - Send a message to channel\n"
-                "/quit                - Exit the chat client\n";
+                "/list                    - List available channels\n"
+                "/create <name>           - Create a new channel\n"
+                "/join <name>             - Join a channel\n"
+                "/users                   - List users in current channel\n"
+                "/dm @user <message>      - Send a private message\n"
+                "/sendfile [@user] <file> - Send a file to the channel or a user\n"
+                "/help                    - Show this help message\n"
+                "/message <message>       - Send a message to channel\n"
+                "/quit                    - Exit the chat client\n";
             std::cout << "> " << std::flush;
             continue;
         }
 
+        if (input_line.rfind("/sendfile ", 0) == 0) {
+            // "/sendfile [@user] <path>": streamed by the client, not sent as one message.
+            std::string arg = input_line.substr(10);
+            std::string target;
+            if (arg.rfind("@", 0) == 0) {
+                size_t end = arg.find(' ');
+                target = arg.substr(0, end);
+                arg = end == std::string::npos ? "" : arg.substr(end + 1);
+            }
+            try {
+                chat_client_ptr->send_file(arg, target);
+            } catch (const std::invalid_argument& e) {
+                std::cerr << "--- " << e.what() << " ---" << std::endl;
+            } catch (const std::runtime_error& e) {
+                std::cerr << "--- Error sending file: " << e.what() << " ---" << std::endl;
+                g_client_running = false;
+                break;
+            }
+            continue;
+        }
+
         if (!input_line.empty()) {
             try {
                 chat_client_ptr->send_message(input_line);
@@ -1,10 +1,20 @@
 #include "chat-client.h"
 #include "../net/chat-sockets.h"
+#include "../net/frame-decoder.h"
+#include "../net/protocol.h"
 #include "../utils.h"
 
+#include <sys/sendfile.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
+#include <fcntl.h>
 #include <unistd.h>
 #include <arpa/inet.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <string_view>
 
 tt::chat::client::Client::Client(int port, const std::string &server_address)
     : socket_{tt::chat::net::create_socket()} {
@@ -12,7 +22,31 @@ tt::chat::client::Client::Client(int port, const std::string &server_address)
     connect_to_server(socket_, address);
 }
 
-void tt::chat::client::Client::send_message(const std::string &message) {
+size_t tt::chat::client::Client::send_message(const std::string &message) {
+    if (protocol_ == net::kProtocolV2) {
+        net::Opcode opcode = net::Opcode::kText;
+        std::string_view payload = message;
+        net::to_v2_command(message, opcode, payload);
+        std::uint8_t flags = 0;
+        if (compressor_ && payload.size() >= net::kDefaultCompressThreshold &&
+            compressor_->compress({&payload, 1}, compress_buf_)) {
+            payload = compress_buf_;
+            flags = net::kFlagCompressed;
+        }
+        std::string frame(net::kV2HeaderSize, '\0');
+        net::write_v2_header(frame.data(), opcode, payload.size(), flags);
+        frame.append(payload);
+        // One write per frame: header and payload never travel in separate segments.
+        size_t sent = 0;
+        while (sent < frame.size()) {
+            ssize_t n = send(socket_, frame.data() + sent, frame.size() - sent, 0);
+            if (n < 0 && errno == EINTR) continue;
+            tt::chat::check_error(n < 0, "Send failed on client socket.");
+            sent += n;
+        }
+        return frame.size();
+    }
+
     std::string len = std::to_string(message.length());
     while(len.size() < 20) len += '\0';
 
@@ -24,6 +58,109 @@ void tt::chat::client::Client::send_message(const std::string &message) {
     if (bytes_sent < 0) {
         tt::chat::check_error(true, "Send failed on client socket.");
     }
+    return len.length() + message.length();
+}
+
+bool tt::chat::client::Client::negotiate_protocol_v2(bool compress) {
+    send_message(compress ? "/proto 2 " + std::string(net::kCompressionName) : "/proto 2");
+    std::string reply;
+    tt::chat::check_error(!receive_message(reply), "Connection closed during protocol negotiation.");
+    if (reply.rfind("Protocol 2", 0) != 0) {
+        return false; // an older server answers "Invalid Command."
+    }
+    protocol_ = net::kProtocolV2;
+    // "Protocol 2 enabled (deflate)." if granted; a server may decline and stay plain.
+    if (compress && reply.find("(" + std::string(net::kCompressionName) + ")") != std::string::npos) {
+        compressor_ = std::make_unique<net::Compressor>();
+        decompressor_ = std::make_unique<net::Decompressor>();
+    }
+    return true;
+}
+
+size_t tt::chat::client::Client::send_file(const std::string &path, const std::string &target) {
+    int file = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat st {};
+    if (file < 0 || fstat(file, &st) < 0 || !S_ISREG(st.st_mode)) {
+        if (file >= 0) close(file);
+        throw std::invalid_argument("Cannot read " + path);
+    }
+    std::string name = path.substr(path.find_last_of('/') + 1);
+    size_t size = st.st_size;
+    send_message("/sendfile " + (target.empty() ? "" : target + " ") + name + " " + std::to_string(size));
+
+    static constexpr std::string_view kChunkWord = "/sendchunk ";
+    off_t offset = 0;
+    while (static_cast<size_t>(offset) < size) {
+        size_t chunk = std::min(net::kFileChunkSize, size - static_cast<size_t>(offset));
+        char header[net::kLengthPrefixSize + kChunkWord.size()];
+        size_t header_len;
+        if (protocol_ == net::kProtocolV2) {
+            net::write_v2_header(header, net::Opcode::kFileChunk, chunk);
+            header_len = net::kV2HeaderSize;
+        } else {
+            net::write_length_prefix(header, kChunkWord.size() + chunk);
+            std::memcpy(header + net::kLengthPrefixSize, kChunkWord.data(), kChunkWord.size());
+            header_len = sizeof(header);
+        }
+        // MSG_MORE lets the header share a segment with the file bytes that follow.
+        send_all(header, header_len, MSG_MORE);
+        for (size_t left = chunk; left > 0;) {
+            ssize_t n = sendfile(socket_, file, &offset, left);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) {
+                // n == 0: the file shrank under us, and the frame can no longer be completed.
+                close(file);
+                tt::chat::check_error(true, "sendfile failed on client socket.");
+            }
+            left -= n;
+        }
+    }
+    close(file);
+    return size;
+}
+
+void tt::chat::client::Client::send_all(const char *data, size_t len, int flags) {
+    size_t sent = 0;
+    while (sent < len) {
+        ssize_t n = send(socket_, data + sent, len - sent, flags);
+        if (n < 0 && errno == EINTR) continue;
+        tt::chat::check_error(n < 0, "Send failed on client socket.");
+        sent += n;
+    }
+}
+
+bool tt::chat::client::Client::receive_message(std::string &body) {
+    size_t body_len;
+    if (protocol_ == net::kProtocolV2) {
+        char header[net::kV2HeaderSize];
+        if (!recv_exact(header, sizeof(header))) return false;
+        body_len = net::read_v2_length(header);
+        if (body_len > kMaxFrameSize) return false;
+        if (header[5] & net::kFlagCompressed) {
+            std::string payload(body_len, '\0');
+            if (!decompressor_ || !recv_exact(payload.data(), body_len)) return false;
+            return decompressor_->decompress(payload, kMaxInflatedSize, body);
+        }
+    } else {
+        char prefix[net::kLengthPrefixSize];
+        if (!recv_exact(prefix, sizeof(prefix))) return false;
+        int len = net::parse_length_prefix(prefix);
+        if (len < 0 || static_cast<size_t>(len) > kMaxFrameSize) return false;
+        body_len = len;
+    }
+    body.resize(body_len);
+    return recv_exact(body.data(), body_len);
+}
+
+bool tt::chat::client::Client::recv_exact(char *out, size_t len) {
+    size_t got = 0;
+    while (got < len) {
+        ssize_t n = recv(socket_, out + got, len - got, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        got += n;
+    }
+    return true;
 }
 
 int tt::chat::client::Client::get_socket_fd() const {
@@ -2,8 +2,11 @@
 #define CHAT_CLIENT_H
 
 #include <netinet/in.h>
+#include <memory>
 #include <string>
 
+#include "../net/compression.h"
+
 namespace tt::chat::client {
     class Client {
         // This class encapsulates the socket connection and basic communication
@@ -16,17 +19,59 @@ namespace tt::chat::client {
          */
         Client(int port, const std::string &server_address);
         /**
-         * @brief Sends a message to the connected server.
+         * @brief Sends a message to the connected server. Under protocol v2 known commands
+         *        ("/join x", "/message y", ...) go out as typed frames; anything else is
+         *        sent as a text command.
          * @param message The message string to send.
+         * @return The number of bytes written to the socket, framing included.
          * @throws std::runtime_error if sending fails or client is not connected.
          */
-        void send_message(const std::string &message);
+        size_t send_message(const std::string &message);
+        /**
+         * @brief Switches the connection to protocol v2 ("/proto 2"). Must be called before
+         *        any other traffic, since it reads the server's answer itself.
+         * @param compress Also ask for compression ("/proto 2 deflate"); payloads of at
+         *        least net::kDefaultCompressThreshold then go out compressed, and
+         *        compressed frames from the server are inflated by receive_message().
+         * @return true if the server accepted v2, with or without compression (see
+         *         compressing()), false if it only speaks v1.
+         * @throws std::runtime_error if the connection fails meanwhile.
+         */
+        bool negotiate_protocol_v2(bool compress = false);
+        /**
+         * @brief Uploads a file: "/sendfile [target] <name> <size>", then the contents
+         *        in chunk frames of net::kFileChunkSize. Only the frame headers pass
+         *        through this process; the file bytes go from the page cache to the
+         *        socket with sendfile(2).
+         * @param path The file to send; the server is told its base name.
+         * @param target "@user", or empty for the current channel.
+         * @return The number of file bytes sent.
+         * @throws std::invalid_argument if the file cannot be opened, before anything is sent.
+         * @throws std::runtime_error if sending fails, which leaves the stream unusable.
+         */
+        size_t send_file(const std::string &path, const std::string &target);
+        /**
+         * @brief Blocks until one complete frame arrives, in the current protocol.
+         * @param body Receives the frame's text.
+         * @return false once the server has closed the connection or a read failed.
+         */
+        bool receive_message(std::string &body);
+        int protocol() const { return protocol_; }
+        bool compressing() const { return compressor_ != nullptr; }
         int get_socket_fd() const; // Getter for the socket
         // Destroys the Client object, ensuring the socket is closed.
         ~Client();
 
     private:
         int socket_;
+        int protocol_ = 1;  // 2 after negotiate_protocol_v2()
+        // Set once the server has agreed to compression.
+        std::unique_ptr<net::Compressor> compressor_;
+        std::unique_ptr<net::Decompressor> decompressor_;
+        std::string compress_buf_;
+
+        bool recv_exact(char *out, size_t len);
+        void send_all(const char *data, size_t len, int flags);
         /**
          * Creates a server address structure (sockaddr_in).
          * @param server_ip The IP address of the server.
@@ -43,6 +88,10 @@ namespace tt::chat::client {
         void connect_to_server(int sock, sockaddr_in &server_address);
 
         static constexpr int kBufferSize = 1024;
+        // Cap on a frame's payload as received, and on what a compressed one may claim to
+        // inflate to. A larger length is treated as a broken stream, never allocated.
+        static constexpr size_t kMaxFrameSize = 16 * 1024 * 1024;
+        static constexpr size_t kMaxInflatedSize = kMaxFrameSize;
     };
 } // namespace tt::chat::client
 
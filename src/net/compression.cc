@@ -0,0 +1,72 @@
+#include "compression.h"
+#include "../utils.h"
+
+#include <zlib.h>
+
+namespace tt::chat::net {
+
+Compressor::Compressor(int level) : stream_(std::make_unique<z_stream_s>()) {
+    check_error(deflateInit(stream_.get(), level) != Z_OK, "deflateInit failed");
+}
+
+Compressor::~Compressor() { deflateEnd(stream_.get()); }
+
+bool Compressor::compress(std::span<const std::string_view> pieces, std::string& out) {
+    size_t total = 0;
+    for (std::string_view piece : pieces) total += piece.size();
+    if (total <= kCompressedLengthSize + 1) {
+        return false;
+    }
+    // Room for one byte less than the input: running out of it means "not worth it",
+    // found without compressing to the end.
+    out.resize(total - 1);
+    out[0] = static_cast<char>(total >> 24);
+    out[1] = static_cast<char>(total >> 16);
+    out[2] = static_cast<char>(total >> 8);
+    out[3] = static_cast<char>(total);
+
+    z_stream_s& z = *stream_;
+    deflateReset(&z);
+    z.next_out = reinterpret_cast<Bytef*>(out.data() + kCompressedLengthSize);
+    z.avail_out = static_cast<uInt>(out.size() - kCompressedLengthSize);
+    for (size_t i = 0; i < pieces.size(); ++i) {
+        z.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(pieces[i].data()));
+        z.avail_in = static_cast<uInt>(pieces[i].size());
+        if (i + 1 == pieces.size()) {
+            if (deflate(&z, Z_FINISH) != Z_STREAM_END) return false;
+        } else if (deflate(&z, Z_NO_FLUSH) == Z_STREAM_ERROR || z.avail_in != 0) {
+            return false;
+        }
+    }
+    out.resize(out.size() - z.avail_out);
+    return true;
+}
+
+Decompressor::Decompressor() : stream_(std::make_unique<z_stream_s>()) {
+    check_error(inflateInit(stream_.get()) != Z_OK, "inflateInit failed");
+}
+
+Decompressor::~Decompressor() { inflateEnd(stream_.get()); }
+
+bool Decompressor::decompress(std::string_view payload, size_t max_size, std::string& out) {
+    if (payload.size() < kCompressedLengthSize) {
+        return false;
+    }
+    auto byte = [&payload](int i) { return static_cast<size_t>(static_cast<unsigned char>(payload[i])); };
+    size_t size = byte(0) << 24 | byte(1) << 16 | byte(2) << 8 | byte(3);
+    if (size > max_size) {
+        return false;
+    }
+    out.resize(size);
+
+    z_stream_s& z = *stream_;
+    inflateReset(&z);
+    z.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(payload.data() + kCompressedLengthSize));
+    z.avail_in = static_cast<uInt>(payload.size() - kCompressedLengthSize);
+    z.next_out = reinterpret_cast<Bytef*>(out.data());
+    z.avail_out = static_cast<uInt>(size);
+    // Exactly `size` bytes and the end of the stream, or the frame is rejected.
+    return inflate(&z, Z_FINISH) == Z_STREAM_END && z.avail_out == 0 && z.avail_in == 0;
+}
+
+} // namespace tt::chat::net
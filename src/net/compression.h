@@ -0,0 +1,70 @@
+#ifndef COMPRESSION_H
+#define COMPRESSION_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+
+struct z_stream_s;
+
+namespace tt::chat::net {
+
+    /**
+     * Optional payload compression for protocol v2, negotiated with "/proto 2 deflate".
+     * A frame with kFlagCompressed in its flags byte carries
+     *
+     *   u32 uncompressed length, big-endian | zlib stream of the payload
+     *
+     * in place of the payload; its header length is that of the compressed form. Each
+     * side compresses only payloads of at least its threshold, and only when the result
+     * is smaller, so every other frame goes out exactly as it would without compression.
+     */
+    constexpr std::uint8_t kFlagCompressed = 0x01;
+    constexpr size_t kCompressedLengthSize = 4;
+    constexpr std::string_view kCompressionName = "deflate";
+    // Client side; the server's is --compress-threshold.
+    constexpr size_t kDefaultCompressThreshold = 1024;
+
+    // One deflate stream, reset between payloads so its state is allocated only once.
+    class Compressor {
+    public:
+        explicit Compressor(int level = 1);
+        ~Compressor();
+
+        Compressor(const Compressor&) = delete;
+        Compressor& operator=(const Compressor&) = delete;
+
+        /**
+         * Compresses the concatenation of `pieces` into `out` (length prefix included),
+         * replacing its contents.
+         * @return false if the result would not be smaller than the input; `out` is
+         *         then unspecified.
+         */
+        bool compress(std::span<const std::string_view> pieces, std::string& out);
+
+    private:
+        std::unique_ptr<z_stream_s> stream_;
+    };
+
+    class Decompressor {
+    public:
+        Decompressor();
+        ~Decompressor();
+
+        Decompressor(const Decompressor&) = delete;
+        Decompressor& operator=(const Decompressor&) = delete;
+
+        // Decodes a compressed payload into `out`. Returns false if it is malformed or
+        // claims more than max_size bytes, which are never allocated.
+        bool decompress(std::string_view payload, size_t max_size, std::string& out);
+
+    private:
+        std::unique_ptr<z_stream_s> stream_;
+    };
+
+} // namespace tt::chat::net
+
+#endif // COMPRESSION_H
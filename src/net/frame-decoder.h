@@ -0,0 +1,129 @@
+#ifndef FRAME_DECODER_H
+#define FRAME_DECODER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+#include "protocol.h"
+
+namespace tt::chat::net {
+
+    // Every frame on the wire is a 20-byte length prefix (ASCII decimal, padded with
+    // '0' or '\0') followed by that many bytes of body.
+    constexpr size_t kLengthPrefixSize = 20;
+
+    // Parses a length prefix the same way the original atoi()-based readers did.
+    inline int parse_length_prefix(const char* prefix) {
+        char len_buf[kLengthPrefixSize + 1];
+        std::memcpy(len_buf, prefix, kLengthPrefixSize);
+        len_buf[kLengthPrefixSize] = '\0';
+        return std::atoi(len_buf);
+    }
+
+    // Writes a zero-padded decimal prefix, the inverse of parse_length_prefix().
+    inline void write_length_prefix(char* out, size_t body_len) {
+        for (size_t i = kLengthPrefixSize; i-- > 0;) {
+            out[i] = static_cast<char>('0' + body_len % 10);
+            body_len /= 10;
+        }
+    }
+
+    /**
+     * Incremental decoder for one connection's byte stream. Reads may end anywhere,
+     * including inside the length prefix; whatever trails the last complete frame is
+     * carried over to the next feed(). Complete frames are handed out as views into the
+     * caller's buffer when possible, so the carry-over is only touched for frames that
+     * straddle two reads and is empty (no allocation) for an idle connection.
+     * Starts in v1 framing; set_version() switches it, effective from the next frame,
+     * even when called from inside on_frame.
+     */
+    class FrameDecoder {
+    public:
+        explicit FrameDecoder(size_t max_frame_size) : max_frame_size_(max_frame_size) {}
+
+        /**
+         * Decodes every complete frame in `data`, calling
+         * on_frame(Opcode opcode, std::string_view payload, std::uint8_t flags) for each;
+         * v1 frames come with Opcode::kText, their whole body and no flags. The decoder
+         * must stay alive until feed() returns.
+         * @return the number of frames decoded, or -1 if a length was invalid
+         *         (the stream cannot be resynchronised after that).
+         */
+        template <typename OnFrame>
+        int feed(const char* data, size_t len, OnFrame&& on_frame) {
+            // Work on a local copy of the carry-over so on_frame may re-enter the owner.
+            std::string carry;
+            if (!carry_.empty()) {
+                carry_.append(data, len);
+                carry.swap(carry_);
+                data = carry.data();
+                len = carry.size();
+            }
+
+            int frames = 0;
+            size_t pos = 0;
+            while (true) {
+                size_t header_size;
+                size_t body_len;
+                Opcode opcode;
+                std::uint8_t flags = 0;
+                if (version_ == kProtocolV2) {
+                    header_size = kV2HeaderSize;
+                    if (len - pos < header_size) break;
+                    body_len = read_v2_length(data + pos);
+                    opcode = static_cast<Opcode>(data[pos + 4]);
+                    flags = static_cast<std::uint8_t>(data[pos + 5]);
+                    // Empty payloads are valid in v2 (e.g. list, users).
+                    if (body_len > max_frame_size_) {
+                        last_invalid_length_ = static_cast<long long>(body_len);
+                        return -1;
+                    }
+                } else {
+                    header_size = kLengthPrefixSize;
+                    if (len - pos < header_size) break;
+                    int prefix_len = parse_length_prefix(data + pos);
+                    if (prefix_len <= 0 || static_cast<size_t>(prefix_len) > max_frame_size_) {
+                        last_invalid_length_ = prefix_len;
+                        return -1;
+                    }
+                    body_len = prefix_len;
+                    opcode = Opcode::kText;
+                }
+                if (len - pos - header_size < body_len) {
+                    break; // body not complete yet
+                }
+                std::string_view body(data + pos + header_size, body_len);
+                pos += header_size + body_len;
+                ++frames;
+                on_frame(opcode, body, flags);
+            }
+
+            if (pos == 0 && !carry.empty()) {
+                // Still no whole frame: keep growing the same buffer, so a large frame
+                // (a file chunk) that arrives over many reads is copied once, not once per read.
+                carry_.swap(carry);
+            } else if (pos < len) {
+                carry_.assign(data + pos, len - pos);
+            }
+            return frames;
+        }
+
+        size_t buffered() const { return carry_.size(); }
+        long long last_invalid_length() const { return last_invalid_length_; }
+        int version() const { return version_; }
+        void set_version(int version) { version_ = version; }
+
+    private:
+        size_t max_frame_size_;
+        std::string carry_;
+        long long last_invalid_length_ = 0;
+        int version_ = kProtocolV1;
+    };
+
+} // namespace tt::chat::net
+
+#endif // FRAME_DECODER_H
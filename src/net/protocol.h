@@ -0,0 +1,101 @@
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace tt::chat::net {
+
+    /**
+     * Protocol v2 framing, negotiated per connection: the client sends the v1 text
+     * command "/proto 2" (or "/proto 2 deflate" to also ask for compression, see
+     * compression.h), the server answers in v1 framing, and from then on every frame in
+     * both directions is an 8-byte binary header followed by a typed payload:
+     *
+     *   bytes 0..3  payload length, big-endian
+     *   byte  4     opcode
+     *   byte  5     flags: kFlagCompressed (compression.h), otherwise 0
+     *   bytes 6..7  reserved, 0
+     *
+     * Payloads carry only the command's argument (a channel name, a username, the chat
+     * text), never the command word, so the server dispatches on the opcode alone.
+     */
+    constexpr size_t kV2HeaderSize = 8;
+
+    constexpr int kProtocolV1 = 1;
+    constexpr int kProtocolV2 = 2;
+
+    enum class Opcode : std::uint8_t {
+        // v1 frames have no opcode; their body is a text command.
+        kText = 0,
+
+        // Client to server.
+        kName = 1,
+        kCreate = 2,
+        kJoin = 3,
+        kList = 4,
+        kUsers = 5,
+        kMessage = 6,
+        kDm = 7,  // "@user text"
+        kSendFile = 8,   // "[@user] <name> <size>", then exactly <size> bytes of kFileChunk
+        kFileChunk = 9,  // raw file bytes
+
+        // Server to client.
+        kReply = 64,           // response or notice addressed to this client
+        kChannelMessage = 65,  // a channel broadcast: "[channel] user: text"
+        kDirectMessage = 66,   // a direct message: "[DM] user: text"
+        kFileStart = 67,       // "[FILE id size] user: name"
+        kFileData = 68,        // "[CHUNK id] " then raw file bytes
+        kFileEnd = 69,         // "[FILE id done]" or "[FILE id aborted]"
+    };
+
+    // One past the highest client-to-server opcode; sizes the server's dispatch table.
+    constexpr size_t kClientOpcodeLimit = 10;
+
+    // File bytes per chunk frame a client sends after /sendfile. The server takes any
+    // chunk size up to its frame limit; this one keeps a chunk within a few recv buffers.
+    constexpr size_t kFileChunkSize = 64 * 1024;
+
+    inline void write_v2_header(char* out, Opcode opcode, size_t payload_len, std::uint8_t flags = 0) {
+        out[0] = static_cast<char>(payload_len >> 24);
+        out[1] = static_cast<char>(payload_len >> 16);
+        out[2] = static_cast<char>(payload_len >> 8);
+        out[3] = static_cast<char>(payload_len);
+        out[4] = static_cast<char>(opcode);
+        out[5] = static_cast<char>(flags);
+        out[6] = 0;
+        out[7] = 0;
+    }
+
+    inline std::uint32_t read_v2_length(const char* header) {
+        auto byte = [header](int i) { return static_cast<std::uint32_t>(static_cast<unsigned char>(header[i])); };
+        return byte(0) << 24 | byte(1) << 16 | byte(2) << 8 | byte(3);
+    }
+
+    // Maps a v1-style text command ("/join general") to its v2 opcode and payload, for
+    // clients that take typed input. Returns false for text with no v2 equivalent.
+    inline bool to_v2_command(std::string_view text, Opcode& opcode, std::string_view& payload) {
+        struct Command {
+            std::string_view word;
+            Opcode opcode;
+        };
+        static constexpr Command kCommands[] = {
+            {"/name", Opcode::kName},   {"/create", Opcode::kCreate}, {"/join", Opcode::kJoin},
+            {"/list", Opcode::kList},   {"/users", Opcode::kUsers},   {"/message", Opcode::kMessage},
+            {"/dm", Opcode::kDm},       {"/sendfile", Opcode::kSendFile}, {"/sendchunk", Opcode::kFileChunk},
+        };
+        std::string_view word = text.substr(0, text.find(' '));
+        for (const Command& command : kCommands) {
+            if (word == command.word) {
+                opcode = command.opcode;
+                payload = word.size() < text.size() ? text.substr(word.size() + 1) : std::string_view();
+                return true;
+            }
+        }
+        return false;
+    }
+
+} // namespace tt::chat::net
+
+#endif // PROTOCOL_H
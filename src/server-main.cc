@@ -1,15 +1,93 @@
 #include <netinet/in.h>
+#include <pthread.h>
 #include <sys/socket.h>
 #include <sys/types.h>
 #include <unistd.h>
+#include <csignal>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
 
 // #include "server/chat-server.h"
 #include "server/epoll-server.h"
-int main() {
-    const int kPort = 8080;
+#include "server/hot-log.h"
+#include "server/metrics-endpoint.h"
+#include "server/server-config.h"
+#include "server/shard-group.h"
+#include "server/state-store.h"
 
-    tt::chat::server::EpollServer server(kPort);
-    server.run();
+namespace {
+void on_stop_signal(int) { tt::chat::server::EpollServer::request_stop(); }
+}
+
+int main(int argc, char* argv[]) {
+    tt::chat::server::ServerConfig config;
+    try {
+        config = tt::chat::server::parse_server_args(argc, argv);
+    } catch (const std::runtime_error& e) {
+        std::cerr << e.what() << std::endl;
+        tt::chat::server::print_server_usage(argv[0]);
+        return 1;
+    }
+
+    // No SA_RESTART: the blocking wait in run() must return EINTR so the loop can exit
+    // and log its stats.
+    struct sigaction sa{};
+    sa.sa_handler = on_stop_signal;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, nullptr);
+    sigaction(SIGTERM, &sa, nullptr);
+    // A peer that disconnects mid-send must cost us an EPIPE, not the whole process.
+    signal(SIGPIPE, SIG_IGN);
+
+    tt::chat::server::ShardGroup group(config.shards, config.history_budget_bytes);
+    // Channels are back before the first client can connect.
+    std::unique_ptr<tt::chat::server::StateStore> state;
+    if (!config.state_dir.empty()) {
+        state = std::make_unique<tt::chat::server::StateStore>(config.state_dir, group.directory());
+        state->restore();
+    }
+    std::vector<std::unique_ptr<tt::chat::server::EpollServer>> shards;
+    for (int i = 0; i < config.shards; ++i) {
+        shards.push_back(std::make_unique<tt::chat::server::EpollServer>(config, group, i));
+    }
+
+    // Stop signals go to this thread only: worker shards inherit a mask that blocks them,
+    // and are woken through their mailboxes once shard 0 has seen the stop request.
+    sigset_t stop_signals;
+    sigemptyset(&stop_signals);
+    sigaddset(&stop_signals, SIGINT);
+    sigaddset(&stop_signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &stop_signals, nullptr);
+    // Helper threads start here too, so they inherit the blocked mask.
+    tt::chat::server::HotLog::start(config.log_mode, config.log_sample, config.log_payload_max,
+                                    config.shards);
+    std::unique_ptr<tt::chat::server::MetricsEndpoint> metrics;
+    if (!config.metrics_socket.empty()) {
+        metrics = std::make_unique<tt::chat::server::MetricsEndpoint>(
+            config.metrics_socket, [&group] { return group.render_metrics(); });
+    }
+    if (state) {
+        state->start(config.snapshot_interval_s);
+    }
+    std::vector<std::thread> workers;
+    for (int i = 1; i < config.shards; ++i) {
+        workers.emplace_back([&shards, i] { shards[i]->run(); });
+    }
+    pthread_sigmask(SIG_UNBLOCK, &stop_signals, nullptr);
+
+    shards[0]->run();
+    group.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    if (state) {
+        state->stop();
+        state->snapshot();
+    }
+    metrics.reset();
+    tt::chat::server::HotLog::stop();
 
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,51 @@
+#ifndef ADAPTIVE_SPIN_H
+#define ADAPTIVE_SPIN_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+
+namespace tt::chat::server {
+
+    /**
+     * Spin-then-block helper for the event loops. Before blocking, the loop polls for
+     * completions for up to budget_us(). The budget doubles (up to the configured
+     * maximum) whenever spinning found work and halves (down to 1/16 of it) whenever it
+     * did not, so a busy server spins long enough to skip the sleep/wake cost while an
+     * idle one quickly falls back to blocking.
+     */
+    class AdaptiveSpin {
+    public:
+        explicit AdaptiveSpin(int max_us) : max_us_(std::max(max_us, 0)), budget_us_(max_us_) {}
+
+        bool enabled() const { return max_us_ > 0; }
+        int budget_us() const { return budget_us_; }
+        std::uint64_t hits() const { return hits_; }
+        std::uint64_t misses() const { return misses_; }
+
+        // Calls poll() until it returns true or the budget runs out. Returns poll's verdict.
+        template <typename Poll>
+        bool spin(Poll&& poll) {
+            auto deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(budget_us_);
+            do {
+                if (poll()) {
+                    ++hits_;
+                    budget_us_ = std::min(budget_us_ * 2, max_us_);
+                    return true;
+                }
+            } while (std::chrono::steady_clock::now() < deadline);
+            ++misses_;
+            budget_us_ = std::max(budget_us_ / 2, std::max(max_us_ / 16, 1));
+            return false;
+        }
+
+    private:
+        int max_us_;
+        int budget_us_;
+        std::uint64_t hits_ = 0;
+        std::uint64_t misses_ = 0;
+    };
+
+} // namespace tt::chat::server
+
+#endif // ADAPTIVE_SPIN_H
@@ -0,0 +1,66 @@
+#include "alloc-stats.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#ifdef ALLOC_STATS_ENABLED
+
+namespace {
+std::atomic<std::uint64_t> g_heap_allocations{0};
+
+void* counted_alloc(std::size_t size) {
+  g_heap_allocations.fetch_add(1, std::memory_order_relaxed);
+  if (size == 0) size = 1;
+  if (void* p = std::malloc(size)) return p;
+  throw std::bad_alloc();
+}
+
+// aligned_alloc wants a size that is a multiple of the alignment.
+void* counted_aligned_alloc(std::size_t size, std::align_val_t alignment) {
+  g_heap_allocations.fetch_add(1, std::memory_order_relaxed);
+  auto align = static_cast<std::size_t>(alignment);
+  size = (size + align - 1) / align * align;
+  if (size == 0) size = align;
+  if (void* p = std::aligned_alloc(align, size)) return p;
+  throw std::bad_alloc();
+}
+} // namespace
+
+namespace tt::chat::server {
+std::uint64_t heap_allocations() {
+  return g_heap_allocations.load(std::memory_order_relaxed);
+}
+} // namespace tt::chat::server
+
+// Replacing the global allocation functions is the only way to see allocations made by
+// the standard library on our behalf (string growth, hash nodes, ...), not just our own.
+// The aligned forms count too: over-aligned types such as SpscQueue's cache-line
+// padded indices go through them.
+void* operator new(std::size_t size) { return counted_alloc(size); }
+void* operator new[](std::size_t size) { return counted_alloc(size); }
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+  try { return counted_alloc(size); } catch (...) { return nullptr; }
+}
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+  try { return counted_alloc(size); } catch (...) { return nullptr; }
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+
+void* operator new(std::size_t size, std::align_val_t alignment) { return counted_aligned_alloc(size, alignment); }
+void* operator new[](std::size_t size, std::align_val_t alignment) { return counted_aligned_alloc(size, alignment); }
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+  try { return counted_aligned_alloc(size, alignment); } catch (...) { return nullptr; }
+}
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+  try { return counted_aligned_alloc(size, alignment); } catch (...) { return nullptr; }
+}
+void operator delete(void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+
+#endif // ALLOC_STATS_ENABLED
@@ -0,0 +1,22 @@
+#ifndef ALLOC_STATS_H
+#define ALLOC_STATS_H
+
+#include <cstdint>
+
+namespace tt::chat::server {
+
+    // Number of global operator new calls made by this process so far.
+    // Used to report heap allocations per message in the server summary. Counting
+    // replaces the global allocator, so it is only built with ALLOC_STATS_ENABLED
+    // (`make ALLOC_STATS=1`, and the benches that report allocations).
+#ifdef ALLOC_STATS_ENABLED
+    constexpr bool kAllocStatsEnabled = true;
+    std::uint64_t heap_allocations();
+#else
+    constexpr bool kAllocStatsEnabled = false;
+    inline std::uint64_t heap_allocations() { return 0; }
+#endif
+
+} // namespace tt::chat::server
+
+#endif // ALLOC_STATS_H
@@ -0,0 +1,129 @@
+#ifndef CHANNEL_HISTORY_H
+#define CHANNEL_HISTORY_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "shared-frame.h"
+
+namespace tt::chat::server {
+
+    /**
+     * Server-wide cap on the bytes held by all channel histories together. Channels
+     * reserve before they store a frame and release what they evict, so usage never
+     * goes over the limit, whichever shards are writing.
+     */
+    class HistoryBudget {
+    public:
+        explicit HistoryBudget(size_t limit_bytes) : limit_(limit_bytes) {}
+
+        bool try_reserve(size_t bytes) {
+            size_t used = used_.load(std::memory_order_relaxed);
+            do {
+                if (used + bytes > limit_) return false;
+            } while (!used_.compare_exchange_weak(used, used + bytes, std::memory_order_relaxed));
+            frames_.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+
+        void release(size_t bytes) {
+            used_.fetch_sub(bytes, std::memory_order_relaxed);
+            frames_.fetch_sub(1, std::memory_order_relaxed);
+        }
+
+        void count_rejected() { rejected_.fetch_add(1, std::memory_order_relaxed); }
+
+        size_t limit() const { return limit_; }
+        size_t used() const { return used_.load(std::memory_order_relaxed); }
+        size_t frames() const { return frames_.load(std::memory_order_relaxed); }
+        // Frames not stored because the budget was spent by other channels.
+        std::uint64_t rejected() const { return rejected_.load(std::memory_order_relaxed); }
+
+    private:
+        const size_t limit_;
+        std::atomic<size_t> used_{0};
+        std::atomic<size_t> frames_{0};
+        std::atomic<std::uint64_t> rejected_{0};
+    };
+
+    /**
+     * The last few broadcasts of one channel, as the encoded v1 frames that were sent,
+     * in a fixed-size ring. Written by whichever shard the sender is on and read by
+     * /history and join replay on any shard, so it has its own small lock; the critical
+     * sections copy frame pointers only.
+     */
+    class ChannelHistory {
+    public:
+        /**
+         * Appends `frame`, evicting this channel's oldest frames when the ring is full or
+         * the shared budget is spent. If the budget cannot be met even with this channel
+         * empty, the frame is not stored.
+         */
+        void push(SharedFrame frame, size_t capacity, HistoryBudget& budget) {
+            if (capacity == 0) return;
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (ring_.size() != capacity) {
+                resize(capacity, budget);
+            }
+            if (count_ == capacity) {
+                evict_oldest(budget);
+            }
+            while (!budget.try_reserve(frame->size())) {
+                if (count_ == 0) {
+                    budget.count_rejected();
+                    return;
+                }
+                evict_oldest(budget);
+            }
+            ring_[(head_ + count_) % capacity] = std::move(frame);
+            ++count_;
+        }
+
+        // Up to the `max_frames` newest frames whose sizes add up to at most `max_bytes`,
+        // oldest first.
+        std::vector<SharedFrame> recent(size_t max_frames, size_t max_bytes) const {
+            std::lock_guard<std::mutex> lock(mutex_);
+            size_t take = 0;
+            size_t bytes = 0;
+            while (take < count_ && take < max_frames) {
+                const SharedFrame& frame = ring_[(head_ + count_ - 1 - take) % ring_.size()];
+                if (bytes + frame->size() > max_bytes) break;
+                bytes += frame->size();
+                ++take;
+            }
+            std::vector<SharedFrame> frames;
+            frames.reserve(take);
+            for (size_t i = count_ - take; i < count_; ++i) {
+                frames.push_back(ring_[(head_ + i) % ring_.size()]);
+            }
+            return frames;
+        }
+
+    private:
+        void evict_oldest(HistoryBudget& budget) {
+            SharedFrame& oldest = ring_[head_];
+            budget.release(oldest->size());
+            oldest.reset();
+            head_ = (head_ + 1) % ring_.size();
+            --count_;
+        }
+
+        // Only the first push sizes the ring; the capacity is a server-wide setting.
+        void resize(size_t capacity, HistoryBudget& budget) {
+            while (count_ > 0) evict_oldest(budget);
+            ring_.assign(capacity, nullptr);
+            head_ = 0;
+        }
+
+        mutable std::mutex mutex_;
+        std::vector<SharedFrame> ring_;
+        size_t head_ = 0;
+        size_t count_ = 0;
+    };
+
+} // namespace tt::chat::server
+
+#endif // CHANNEL_HISTORY_H
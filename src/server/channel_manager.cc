@@ -2,30 +2,37 @@
 
 namespace tt::chat::server {
 
-    void ChannelManager::create_channel(const std::string &name) {
-        channels_[name];  // default-initialize set
-    }
-
-    bool ChannelManager::has_channel(const std::string &name) const {
-        return channels_.find(name) != channels_.end();
-    }
-
-    std::unordered_set<int>& ChannelManager::get_members(const std::string &name) {
-        return channels_[name];
+    void ChannelManager::join_channel(ChannelId channel, int client_fd) {
+        if (channel >= members_.size()) {
+            members_.resize(channel + 1);
+        }
+        if (static_cast<size_t>(client_fd) >= positions_.size()) {
+            positions_.resize(client_fd + 1);
+        }
+        positions_[client_fd] = members_[channel].size();
+        members_[channel].push_back(client_fd);
     }
 
-    std::vector<std::string> ChannelManager::list_channels() const {
-        std::vector<std::string> result;
-        for (const auto &[name, _] : channels_) result.push_back(name);
-        return result;
+    void ChannelManager::leave_channel(ChannelId channel, int client_fd) {
+        if (channel >= members_.size() || static_cast<size_t>(client_fd) >= positions_.size()) {
+            return;
+        }
+        std::vector<int>& members = members_[channel];
+        std::uint32_t pos = positions_[client_fd];
+        if (pos >= members.size() || members[pos] != client_fd) {
+            return;  // not a member
+        }
+        int last = members.back();
+        members[pos] = last;
+        positions_[last] = pos;
+        members.pop_back();
     }
 
-    void ChannelManager::join_channel(const std::string &name, const std::string &prev_channel, int client_fd) {
-        if(prev_channel != "") {
-            channels_[prev_channel].erase(client_fd);
+    std::span<const int> ChannelManager::members(ChannelId channel) const {
+        if (channel >= members_.size()) {
+            return {};
         }
-        create_channel(name);
-        channels_[name].insert(client_fd);
+        return members_[channel];
     }
 
-} // namespace tt::chat::server
\ No newline at end of file
+} // namespace tt::chat::server
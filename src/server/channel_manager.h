@@ -1,25 +1,32 @@
 #ifndef CHANNEL_MANAGER_H
 #define CHANNEL_MANAGER_H
 
-#include <unordered_map>
-#include <unordered_set>
-#include <string>
+#include <cstdint>
+#include <span>
 #include <vector>
 
+#include "shard-directory.h"
+
 namespace tt::chat::server {
 
+    /**
+     * This shard's channel members, keyed by the channel's interned id. Each channel's
+     * members are a contiguous fd array, so a fan-out is a linear scan; removal swaps
+     * the last member into the hole, found through a per-fd back-index. A client is a
+     * member of at most one channel at a time.
+     */
     class ChannelManager {
     public:
-        void create_channel(const std::string &name);
-        bool has_channel(const std::string &name) const;
-        std::unordered_set<int>& get_members(const std::string &name);
-        std::vector<std::string> list_channels() const;
-        void join_channel(const std::string &name, const std::string &prev_channel, int client_fd);
+        void join_channel(ChannelId channel, int client_fd);
+        void leave_channel(ChannelId channel, int client_fd);
+        // Empty for a channel with no local members, including one never seen here.
+        std::span<const int> members(ChannelId channel) const;
 
     private:
-        std::unordered_map<std::string, std::unordered_set<int>> channels_;
+        std::vector<std::vector<int>> members_;   // by channel id
+        std::vector<std::uint32_t> positions_;    // by fd: index in its channel's array
     };
 
 } // namespace tt::chat::server
 
-#endif // CHANNEL_MANAGER_H
\ No newline at end of file
+#endif // CHANNEL_MANAGER_H
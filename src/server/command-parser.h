@@ -0,0 +1,136 @@
+#ifndef COMMAND_PARSER_H
+#define COMMAND_PARSER_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace tt::chat::server {
+
+    enum class Command : std::uint8_t {
+        kUnknown,
+        kName,
+        kCreate,
+        kJoin,
+        kList,
+        kUsers,
+        kMessage,
+        kProto,
+        kBigmsg,
+        kStats,
+        kHistory,
+        kDm,
+        kSendFile,
+        kSendChunk,
+        kCount,
+    };
+
+    // A text command split into its command and its argument. Both are views into the
+    // frame being parsed; nothing is copied.
+    struct ParsedCommand {
+        Command command = Command::kUnknown;
+        std::string_view word;  // the command word as sent, e.g. "/join"
+        std::string_view arg;   // trimmed (except for /sendchunk), may be empty
+    };
+
+    namespace detail {
+
+        constexpr std::string_view kWhitespace = " \t\r\f\v\n";
+
+        struct CommandName {
+            std::string_view word;
+            Command command;
+        };
+
+        constexpr CommandName kCommandNames[] = {
+            {"/name", Command::kName},       {"/create", Command::kCreate}, {"/join", Command::kJoin},
+            {"/list", Command::kList},       {"/users", Command::kUsers},   {"/message", Command::kMessage},
+            {"/proto", Command::kProto},     {"/bigmsg", Command::kBigmsg}, {"/stats", Command::kStats},
+            {"/history", Command::kHistory}, {"/dm", Command::kDm},         {"/sendfile", Command::kSendFile},
+            {"/sendchunk", Command::kSendChunk},
+        };
+
+        // Every command word starts with '/', so length and second character are enough
+        // to tell them apart; the table below is only valid while that stays true.
+        constexpr size_t kSlots = 32;
+        constexpr size_t command_slot(std::string_view word) {
+            return (word.size() + static_cast<unsigned char>(word[1])) & (kSlots - 1);
+        }
+
+        constexpr std::array<CommandName, kSlots> make_command_table() {
+            std::array<CommandName, kSlots> table{};
+            for (const CommandName& name : kCommandNames) {
+                table[command_slot(name.word)] = name;
+            }
+            return table;
+        }
+
+        constexpr bool command_table_is_perfect() {
+            constexpr auto table = make_command_table();
+            for (const CommandName& name : kCommandNames) {
+                if (table[command_slot(name.word)].command != name.command) return false;
+            }
+            return true;
+        }
+        static_assert(command_table_is_perfect(), "two command words hash to the same slot");
+
+        constexpr std::array<CommandName, kSlots> kCommandTable = make_command_table();
+
+    } // namespace detail
+
+    constexpr Command lookup_command(std::string_view word) {
+        if (word.size() < 2) {
+            return Command::kUnknown;
+        }
+        const detail::CommandName& entry = detail::kCommandTable[detail::command_slot(word)];
+        return entry.word == word ? entry.command : Command::kUnknown;
+    }
+
+    // The command word without its slash ("join"), or "unknown"; used as a metrics label.
+    constexpr std::string_view command_name(Command command) {
+        for (const detail::CommandName& name : detail::kCommandNames) {
+            if (name.command == command) return name.word.substr(1);
+        }
+        return "unknown";
+    }
+
+    /**
+     * Splits "<command> <argument>" the way the text protocol always has: the command
+     * ends at the first whitespace character, and the argument is the rest with leading
+     * and trailing whitespace removed. /sendchunk carries file bytes, so its argument
+     * is everything after the single space, untouched.
+     */
+    constexpr ParsedCommand parse_command(std::string_view msg) {
+        ParsedCommand parsed;
+        size_t word_end = msg.find_first_of(detail::kWhitespace);
+        parsed.word = msg.substr(0, word_end);
+        parsed.command = lookup_command(parsed.word);
+        if (word_end == std::string_view::npos) {
+            return parsed;
+        }
+        if (parsed.command == Command::kSendChunk) {
+            parsed.arg = msg.substr(word_end + 1);
+            return parsed;
+        }
+        std::string_view rest = msg.substr(word_end);
+        size_t first = rest.find_first_not_of(detail::kWhitespace);
+        if (first != std::string_view::npos) {
+            size_t last = rest.find_last_not_of(detail::kWhitespace);
+            parsed.arg = rest.substr(first, last - first + 1);
+        }
+        return parsed;
+    }
+
+    static_assert(parse_command("/join  general \n").command == Command::kJoin);
+    static_assert(parse_command("/join  general \n").arg == "general");
+    static_assert(parse_command("/list").arg.empty());
+    static_assert(parse_command("/message a  b ").arg == "a  b");
+    static_assert(parse_command("/nam x").command == Command::kUnknown);
+    static_assert(parse_command("").command == Command::kUnknown);
+    static_assert(parse_command("/sendchunk  a\n").arg == " a\n");
+    static_assert(command_name(Command::kJoin) == "join");
+
+} // namespace tt::chat::server
+
+#endif // COMMAND_PARSER_H
@@ -0,0 +1,99 @@
+#ifndef CONNECTION_H
+#define CONNECTION_H
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <sys/epoll.h>
+#include <utility>
+#include <vector>
+
+#include "outbound-queue.h"
+#include "shard-directory.h"
+#include "../net/frame-decoder.h"
+
+struct IoUringContext;
+
+namespace tt::chat::server {
+
+    /**
+     * Everything the shard knows about one client, in one place: who it is, where it
+     * is, its half-read input and its queued output. conn_id tells a live connection
+     * apart from an earlier one that had the same fd, whose late completions must be
+     * ignored; 0 marks a free table slot.
+     */
+    struct Connection {
+        Connection() : decoder(0) {}
+        Connection(std::uint64_t id, int fd, size_t max_frame_size)
+            : conn_id(id), name("user_" + std::to_string(fd)), decoder(max_frame_size) {}
+
+        bool active() const { return conn_id != 0; }
+
+        std::uint64_t conn_id = 0;
+        std::string name;            // username, or the temporary "user_<fd>"
+        bool has_username = false;
+        ChannelEntry* channel = nullptr;
+        // Framing of everything sent to this client; the decoder tracks the inbound side.
+        int protocol = net::kProtocolV1;
+        bool compress = false;  // v2 only: negotiated "/proto 2 deflate" (compression.h)
+
+        // Input: only holds bytes of a frame split across reads.
+        net::FrameDecoder decoder;
+
+        // The /sendfile upload this client is streaming, if any (file-transfer.h).
+        std::shared_ptr<FileTransfer> upload;
+
+        // Output.
+        OutboundQueue out;
+        bool flush_scheduled = false;  // waiting in the server's per-iteration flush list
+        // Set once the connection is being torn down (kicked, broken framing, failed
+        // write): nothing more is queued and the recv side finishes the teardown.
+        bool closing = false;
+        // Pause policy: how many congested queues are holding this client's reads, and
+        // which senders this client's own queue is holding (fd, conn_id).
+        int read_pauses = 0;
+        std::vector<std::pair<int, std::uint64_t>> paused_senders;
+        #ifdef IO_URING_ENABLED
+            IoUringContext* parked_recv = nullptr;  // recv not re-armed while paused
+        #else
+            std::uint32_t epoll_events = EPOLLIN | EPOLLOUT | EPOLLET | EPOLLRDHUP;  // registered set
+        #endif
+
+        // Counters.
+        std::uint64_t messages_in = 0;
+        std::uint64_t bytes_in = 0;
+        std::uint64_t frames_out = 0;
+    };
+
+    /**
+     * Connections stored densely, indexed by fd (or fixed-file slot), so the per-message
+     * path is one bounds check and one array access instead of a hash lookup per field.
+     * References stay valid until the next open(), which may grow the table.
+     */
+    class ConnectionTable {
+    public:
+        Connection& open(int fd, std::uint64_t conn_id, size_t max_frame_size) {
+            if (static_cast<size_t>(fd) >= slots_.size()) {
+                slots_.resize(std::max(slots_.size() * 2, static_cast<size_t>(fd) + 1));
+            }
+            slots_[fd] = Connection(conn_id, fd, max_frame_size);
+            return slots_[fd];
+        }
+
+        Connection* find(int fd) {
+            if (fd < 0 || static_cast<size_t>(fd) >= slots_.size() || !slots_[fd].active()) {
+                return nullptr;
+            }
+            return &slots_[fd];
+        }
+
+        void close(int fd) { slots_[fd] = Connection(); }
+
+    private:
+        std::vector<Connection> slots_;
+    };
+
+} // namespace tt::chat::server
+
+#endif // CONNECTION_H
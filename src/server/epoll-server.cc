@@ -3,36 +3,38 @@
 #include "../net/chat-sockets.h"
 
 #include "channel_manager.h"
+#include "alloc-stats.h"
+#include "hot-log.h"
 
 #include <spdlog/spdlog.h>
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <fcntl.h>
 #include <fstream>
+#include <optional>
 #include <cctype> 
+#include <thread>
+#include <utility>
 
 namespace tt::chat::server {
-void split_message(const std::string& msg,std::string& msg_type,std::string& msg_content){
-    size_t first_whitespace = msg.find_first_of(" \t\r\f\v\n");
-    if(first_whitespace==std::string::npos){
-      msg_type=msg;
-      msg_content="";
-      return;
-    }
-    std::string command_args=msg.substr(first_whitespace);
-    size_t first_content_character_substring=command_args.find_first_not_of(" \t\r\f\v\n");
-    size_t last_content_character_substring=command_args.find_last_not_of(" \t\r\f\v\n");
-    msg_type=msg.substr(0,first_whitespace);
-    if(first_content_character_substring==std::string::npos){
-      msg_content="";
-      return;
-    }
-    msg_content=command_args.substr(first_content_character_substring,
-                last_content_character_substring-first_content_character_substring+1);
-}
-EpollServer::EpollServer(int port) {
-  setup_server_socket(port);
+EpollServer::EpollServer(const ServerConfig& config, ShardGroup& group, int shard_id)
+    : config_(config), group_(group), shard_id_(shard_id), spin_(config.spin_us),
+      compressor_(config.compress_level) {
+  group_.register_stats(shard_id_, stats_);
+  // Every shard binds its own listening socket; SO_REUSEPORT lets the kernel spread
+  // incoming connections across them.
+  setup_server_socket(config_.port, group_.size() > 1);
 
   #ifdef IO_URING_ENABLED
     setup_io_uring();
     submit_accept();
+    {
+      IoUringContext* wakeup = new_context(IO_WAKEUP, group_.mailbox(shard_id_).event_fd());
+      wakeup->buffer = wakeup->inline_buf;
+      wakeup->buffer_size = sizeof(std::uint64_t);
+      submit_wakeup_read(wakeup);
+    }
   #else   
     setup_epoll();
     check_error(epoll_fd_ < 0, "epoll_create1 failed");
@@ -40,15 +42,25 @@ EpollServer::EpollServer(int port) {
     ev.events = EPOLLIN;
     ev.data.fd = listen_sock_;
     check_error(epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, listen_sock_, &ev) < 0, "epoll_ctl listen_sock");
+    ev.data.fd = group_.mailbox(shard_id_).event_fd();
+    check_error(epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, ev.data.fd, &ev) < 0, "epoll_ctl mailbox");
   #endif
 
   // Initialize the ChannelManager
   channel_mgr_ = std::make_unique<ChannelManager>();
+
+  if (!config_.message_log_dir.empty()) {
+    message_log_ = std::make_unique<MessageLog>(config_.message_log_dir, shard_id_, config_.durability,
+                                                config_.message_log_segment_bytes);
+  }
 }
 
 EpollServer::~EpollServer() {
   close(listen_sock_);
   #ifdef IO_URING_ENABLED
+    if (buf_ring_) {
+      io_uring_free_buf_ring(&ring_, buf_ring_, kBufRingEntries, kBufGroupId);
+    }
     io_uring_queue_exit(&ring_);
   #else
     close(epoll_fd_);
@@ -58,281 +70,1251 @@ EpollServer::~EpollServer() {
 #ifndef IO_URING_ENABLED
   void EpollServer::setup_epoll() {
       epoll_fd_ = epoll_create1(0);
+      rx_buffer_ = std::make_unique<char[]>(kRecvBufferSize);
   }
   void EpollServer::handle_epoll_events(epoll_event events[]) {
-    while (true) {
-      int nfds = epoll_wait(epoll_fd_, events, kMaxEvents, -1);
+    int mailbox_fd = group_.mailbox(shard_id_).event_fd();
+    std::vector<int> backlog;
+    while (!stop_requested_.load(std::memory_order_relaxed)) {
+      // Messages the last iteration appended go to disk (and are then delivered) here,
+      // one write and fsync for all of them.
+      commit_message_log();
+      // Everything queued for a client this iteration leaves in one send.
+      flush_due_clients();
+      ring_doorbells();
+      int nfds = 0;
+      if (spin_.enabled() && read_backlog_.empty()) {
+        spin_.spin([&] {
+          nfds = epoll_wait(epoll_fd_, events, kMaxEvents, 0);
+          stats_.syscalls++;
+          return nfds != 0;
+        });
+      }
+      if (nfds == 0) {
+        // Clients left with unread data must not wait for an edge that will never come,
+        // nor held output past its budget (rounded up to epoll_wait's milliseconds).
+        int timeout_ms = 0;
+        if (read_backlog_.empty()) {
+          std::int64_t wait_ns = flush_wait_ns();
+          timeout_ms = wait_ns < 0 ? -1 : static_cast<int>((wait_ns + 999999) / 1000000);
+        }
+        nfds = epoll_wait(epoll_fd_, events, kMaxEvents, timeout_ms);
+        stats_.syscalls++;
+      }
+      if (nfds < 0) {
+        check_error(errno != EINTR, "epoll_wait failed");
+        continue;
+      }
+      stats_.loop_iterations++;
+      stats_.completions_per_loop.record(nfds);
       for (int i = 0; i < nfds; ++i) {
         int fd = events[i].data.fd;
         if (fd == listen_sock_) {
           handle_new_connection();
-        } else {
+          continue;
+        }
+        if (fd == mailbox_fd) {
+          group_.mailbox(shard_id_).consume_notification();
+          drain_mailbox();
+          continue;
+        }
+        if (events[i].events & EPOLLOUT) {
+          if (Connection* conn = connections_.find(fd)) {
+            flush_outbound(fd, *conn);
+          }
+        }
+        // HUP/ERR are reported even while EPOLLIN is paused; recv() surfaces them
+        if (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
           handle_client_data(fd);
         }
       }
+      // An fd may have been closed and reused since it was queued; a spare read of a new
+      // client just hits EAGAIN.
+      backlog.swap(read_backlog_);
+      for (int fd : backlog) {
+        handle_client_data(fd);
+      }
+      backlog.clear();
     }
   }
+
+  void EpollServer::update_epoll_events(int client_sock, Connection& conn) {
+    // A closing client is read regardless of pauses so its EOF reaches the teardown.
+    // EPOLLOUT stays registered: with EPOLLET it only fires when the send buffer drains,
+    // and a MOD here re-reports EPOLLIN if data arrived while reads were paused.
+    std::uint32_t events = EPOLLOUT | EPOLLET | EPOLLRDHUP;
+    if (conn.read_pauses == 0 || conn.closing) events |= EPOLLIN;
+    if (events == conn.epoll_events) return;
+
+    epoll_event ev{};
+    ev.events = events;
+    ev.data.fd = client_sock;
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, client_sock, &ev) < 0) {
+      SPDLOG_ERROR("epoll_ctl MOD failed for client {}: {}", client_sock, strerror(errno));
+      return;
+    }
+    conn.epoll_events = events;
+  }
 #endif
 
-void EpollServer::setup_server_socket(int port) {
+void EpollServer::setup_server_socket(int port, bool reuse_port) {
   listen_sock_ = net::create_socket();
   sockaddr_in address = net::create_address(port);
   address.sin_addr.s_addr = INADDR_ANY;
 
   int opt = 1;
   setsockopt(listen_sock_, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+  if (config_.busy_poll_us > 0) {
+    // Copied into every accepted socket, including fixed-file accepts that never expose an fd
+    int busy_poll = config_.busy_poll_us;
+    if (setsockopt(listen_sock_, SOL_SOCKET, SO_BUSY_POLL, &busy_poll, sizeof(busy_poll)) < 0) {
+      SPDLOG_WARN("SO_BUSY_POLL unavailable ({}), continuing without it", strerror(errno));
+    }
+  }
+  if (reuse_port) {
+    check_error(setsockopt(listen_sock_, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) < 0,
+                "SO_REUSEPORT failed");
+  }
+  #ifndef IO_URING_ENABLED
+    // Accepts are drained until EAGAIN, never allowed to block the loop.
+    check_error(fcntl(listen_sock_, F_SETFL, fcntl(listen_sock_, F_GETFL) | O_NONBLOCK) < 0,
+                "fcntl O_NONBLOCK failed");
+  #endif
   check_error(bind(listen_sock_, (sockaddr *)&address, sizeof(address)) < 0, "bind failed");
   check_error(listen(listen_sock_, 10) < 0, "listen failed");
 }
 
-void EpollServer::handle_new_connection() {
-  sockaddr_in client_addr;
-  socklen_t addrlen = sizeof(client_addr);
-  int client_sock = accept(listen_sock_, (sockaddr *)&client_addr, &addrlen);
-  check_error(client_sock < 0, "accept failed");
+#ifndef IO_URING_ENABLED
+  void EpollServer::handle_new_connection() {
+    while (true) {
+      sockaddr_in client_addr;
+      socklen_t addrlen = sizeof(client_addr);
+      int client_sock = accept4(listen_sock_, (sockaddr *)&client_addr, &addrlen,
+                                SOCK_NONBLOCK | SOCK_CLOEXEC);
+      if (client_sock < 0) {
+        if (errno == EINTR || errno == ECONNABORTED) continue;
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+          SPDLOG_ERROR("accept failed: {}", strerror(errno));
+        }
+        return;
+      }
 
-  epoll_event ev{};
-  ev.events = EPOLLIN;
-  ev.data.fd = client_sock;
-  check_error(epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, client_sock, &ev) < 0, "epoll_ctl client_sock");
+      epoll_event ev{};
+      ev.events = EPOLLIN | EPOLLOUT | EPOLLET | EPOLLRDHUP;
+      ev.data.fd = client_sock;
+      if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, client_sock, &ev) < 0) {
+        SPDLOG_ERROR("epoll_ctl ADD failed for client {}: {}", client_sock, strerror(errno));
+        close(client_sock);
+        continue;
+      }
 
-  client_usernames_[client_sock] = "user_" + std::to_string(client_sock);  // temporary username
-  SPDLOG_INFO("New connection: {}", client_usernames_[client_sock]);
-}
+      open_connection(client_sock);
+      stats_.connections_accepted++;
+      HOT_LOG_INFO("New connection: user_{}", client_sock);
+    }
+  }
+#endif
 
-void EpollServer::handle_name_command(int client_sock, const std::string& new_name) {
+void EpollServer::handle_name_command(int client_sock, std::string_view arg) {
+  std::string new_name(arg);
   if (new_name.empty()) {
     send_message(client_sock, "Username cannot be created.\n");
     SPDLOG_WARN("Client {} attempted to set an empty username.", client_sock);
     return;
   }
-  if (username_set_.count(new_name)) {
+  // Also releases the client's previous name, and points the DM index at this client
+  Connection* conn = connections_.find(client_sock);
+  if (!group_.directory().claim_username(client_key(client_sock), conn->conn_id, new_name)) {
     send_message(client_sock, "Duplicate usernames are not allowed.\n");
     SPDLOG_WARN("Client {} attempted to duplicate a username.", client_sock);
     return;
   }
-  // Remove old username from set if exists
-  if (usernames_.count(client_sock)) {
-    username_set_.erase(usernames_[client_sock]);
-  }
 
-  usernames_[client_sock] = new_name;
-  username_set_.insert(new_name);
+  conn->name = new_name;
+  conn->has_username = true;
   std::string welcome = "Welcome, " + new_name + "!\n";
   send_message(client_sock, welcome);
   SPDLOG_INFO("Client {} assigned username '{}'", client_sock, new_name);
 }
 
-void EpollServer::handle_client_data(int client_sock) {
-    char len_buf[20 + 1]; // +1 for null terminator
-    len_buf[20] = '\0'; // Ensure null termination
+#ifndef IO_URING_ENABLED
+  void EpollServer::handle_client_data(int client_sock) {
+    // Edge-triggered: read until EAGAIN, or until this client has had its share of the
+    // iteration, in which case it goes to the backlog instead of waiting for a new edge.
+    for (int reads = 0;; ++reads) {
+      Connection* conn = connections_.find(client_sock);
+      if (!conn) {
+        return; // disconnected
+      }
+      if (conn->read_pauses > 0 && !conn->closing) {
+        return; // resume_reads() re-registers EPOLLIN, which re-reports pending data
+      }
+      if (reads == kMaxReadsPerEvent) {
+        read_backlog_.push_back(client_sock);
+        return;
+      }
 
-    ssize_t total_received_len = 0;
-    while (total_received_len < 20) {
-        ssize_t received_bytes = recv(client_sock, len_buf + total_received_len, 20 - total_received_len, 0);
-        if (received_bytes < 0) {
-            if (errno == EINTR) continue; // Interrupted system call, retry
-            SPDLOG_ERROR("Error reading message length from client {}: {}. Disconnecting.", client_sock, strerror(errno));
-            return;
-        }
-        if (received_bytes == 0) { // Client disconnected gracefully
-            SPDLOG_INFO("Client {} disconnected during length read. Disconnecting.", client_sock);
-            return;
-        }
-        total_received_len += received_bytes;
-    }
+      ssize_t received_bytes = recv(client_sock, rx_buffer_.get(), kRecvBufferSize, 0);
+      stats_.syscalls++;
+      if (received_bytes < 0) {
+        if (errno == EINTR) continue;
+        if (errno == EAGAIN || errno == EWOULDBLOCK) return;
+        SPDLOG_ERROR("Error reading from client {}: {}. Disconnecting.", client_sock, strerror(errno));
+        handle_client_disconnect(client_sock);
+        return;
+      }
+      if (received_bytes == 0) { // Client disconnected gracefully
+        HOT_LOG_INFO("Client {} disconnected. Disconnecting.", client_sock);
+        handle_client_disconnect(client_sock);
+        return;
+      }
 
-    int msg_length = atoi(len_buf);
-    if (msg_length <= 0) {
-        SPDLOG_WARN("Client {} sent invalid message length: '{}' (parsed as {}). Disconnecting.",
-                    client_sock, len_buf, msg_length);
+      stats_.recv_completions++;
+      stats_.bytes_received += received_bytes;
+      if (!decode_client_bytes(client_sock, rx_buffer_.get(), received_bytes)) {
         send_message(client_sock, "Server: Invalid message format (length).\n"); // Try to send error
+        handle_client_disconnect(client_sock);
         return;
+      }
     }
+  }
+#endif
 
-    std::vector<char> buffer(msg_length);
+bool EpollServer::decode_client_bytes(int client_sock, const char* data, size_t len) {
+  Connection* conn = connections_.find(client_sock);
+  if (!conn) {
+    return true;
+  }
+  conn->bytes_in += len;
+  // The table does not grow while frames are dispatched, so conn stays valid.
+  net::FrameDecoder& decoder = conn->decoder;
+  int frames = decoder.feed(data, len, [&](net::Opcode opcode, std::string_view body, std::uint8_t flags) {
+    conn->messages_in++;
+    if (flags & net::kFlagCompressed) {
+      auto start = std::chrono::steady_clock::now();
+      if (!conn->compress || !decompressor_.decompress(body, MAX_MESSAGE_SIZE, inflate_buf_)) {
+        stats_.decompress_errors++;
+        send_message(client_sock, "Invalid compressed frame.\n");
+        return;
+      }
+      stats_.decompress_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now() - start).count();
+      stats_.frames_decompressed++;
+      stats_.decompress_bytes_in += body.size();
+      stats_.decompress_bytes_out += inflate_buf_.size();
+      // Nothing below decodes another frame, so the buffer outlives every use of body.
+      body = inflate_buf_;
+    }
+    stats_.on_message(heap_allocations());
+    HOT_LOG_INFO("Received from client {}: opcode={} length={} message='{}'",
+                 client_sock, static_cast<int>(opcode), body.size(), HotLog::payload(body));
+    if (opcode == net::Opcode::kText) {
+      parse_client_command(client_sock, body);
+    } else {
+      dispatch_v2(client_sock, opcode, body);
+    }
+  });
+  if (frames < 0) {
+    SPDLOG_WARN("Client {} sent invalid message length: {}. Disconnecting.",
+                client_sock, decoder.last_invalid_length());
+    return false;
+  }
+  return true;
+}
 
-    ssize_t received_bytes = recv(client_sock, buffer.data(), msg_length, 0);
-    if(received_bytes < msg_length) {
-      std::cout << received_bytes << " " << msg_length << "\n";
+void EpollServer::handle_client_disconnect(int client_fd) {
+  HOT_LOG_INFO("Client {} disconnected.", client_fd);
+  
+  // An in-flight send keeps its own frame reference; its completion finds the conn_id
+  // gone and is dropped.
+  if (Connection* conn = connections_.find(client_fd)) {
+    // Output held for coalescing (a last error reply, say) still goes out first.
+    if (conn->flush_scheduled) {
+      flush_outbound(client_fd, *conn);
+    }
+    if (conn->upload) {
+      finish_upload(client_fd, *conn, false);
     }
-    std::string msg(buffer.data(), msg_length); // Create string from the exact read bytes
-    SPDLOG_INFO("Received from client {}: length={} message='{}'", client_sock, msg_length, msg);
+    leave_current_channel(client_fd, *conn);
+    group_.directory().release_client(client_key(client_fd));
+    release_paused_senders(*conn);
+    stats_.queued_bytes -= conn->out.bytes();
+    #ifdef IO_URING_ENABLED
+      if (conn->parked_recv) release_context(conn->parked_recv);
+    #endif
+    connections_.close(client_fd);
+  }
+  
+  // State must be gone before the id is released: the next accept may reuse it.
+  #ifdef IO_URING_ENABLED
+    close_client_file(client_fd);
+  #else
+    epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, client_fd, nullptr);
+    close(client_fd);
+  #endif
+}
+
+
+Connection& EpollServer::open_connection(int client_fd) {
+  return connections_.open(client_fd, next_conn_id_++, MAX_MESSAGE_SIZE);
+}
+
+void EpollServer::leave_current_channel(int client_sock, Connection& conn) {
+  if (!conn.channel) {
+    return;
+  }
+  channel_mgr_->leave_channel(conn.channel->id, client_sock);
+  group_.directory().leave(conn.channel, shard_id_, client_key(client_sock));
+  conn.channel = nullptr;
+}
 
-    parse_client_command(client_sock, msg);
+void EpollServer::move_to_channel(int client_sock, ChannelEntry* channel) {
+  Connection* conn = connections_.find(client_sock);
+  leave_current_channel(client_sock, *conn);
+  channel_mgr_->join_channel(channel->id, client_sock);
+  group_.directory().join(channel, shard_id_, client_key(client_sock));
+  conn->channel = channel;
 }
 
+void EpollServer::parse_client_command(int client_sock, std::string_view msg) {
+  // Views into the receive buffer all the way to the handler; no copies, no allocation.
+  ParsedCommand parsed = parse_command(msg);
+  run_command(client_sock, parsed.command, parsed.arg);
+}
 
-void EpollServer::parse_client_command(int client_sock, const std::string& msg){
-  std::string msg_type,msg_content;
-  split_message(msg,msg_type,msg_content);
-  if(msg_type=="/name"){
-    handle_name_command(client_sock, msg_content);
+void EpollServer::dispatch_v2(int client_sock, net::Opcode opcode, std::string_view payload) {
+  static constexpr Command kOpcodeCommands[net::kClientOpcodeLimit] = {
+      Command::kUnknown,  // kText never gets here
+      Command::kName,
+      Command::kCreate,
+      Command::kJoin,
+      Command::kList,
+      Command::kUsers,
+      Command::kMessage,
+      Command::kDm,
+      Command::kSendFile,
+      Command::kSendChunk,
+  };
+  size_t index = static_cast<size_t>(opcode);
+  if (index >= net::kClientOpcodeLimit) {
+    SPDLOG_WARN("Client {} sent unknown opcode {}.", client_sock, index);
+    run_command(client_sock, Command::kUnknown, payload);
+    return;
   }
-  else if(msg_type=="/create"){
-    handle_create_command(client_sock, msg_content);
-  } 
-  else if (msg_type=="/join") {
-    handle_join_command(client_sock, msg_content);
-  } else if (msg_type=="/list") {
-    handle_list_command(client_sock);
-  } else if (msg_type == "/users") {
-    handle_users_command(client_sock);
-  } else if (msg.rfind("/bigmsg ", 0) == 0) {
-    std::string num = msg.substr(8);
-    std::string bmsg = "";
-    int len = stoi(num);
-    for(int i=0; i<len; i++) 
-      bmsg += 'a';
-    handle_channel_message(client_sock, bmsg);
-  } else if(msg_type=="/message"){
-    handle_channel_message(client_sock, msg_content);
-  } else{
-    send_message(client_sock, "Invalid Command.\n");
-    SPDLOG_WARN("Client {} entered an invalid command.", client_sock);
+  run_command(client_sock, kOpcodeCommands[index], payload);
+}
+
+void EpollServer::run_command(int client_sock, Command command, std::string_view arg) {
+  static constexpr CommandHandler kHandlers[static_cast<size_t>(Command::kCount)] = {
+      &EpollServer::handle_invalid_command,
+      &EpollServer::handle_name_command,
+      &EpollServer::handle_create_command,
+      &EpollServer::handle_join_command,
+      &EpollServer::handle_list_command,
+      &EpollServer::handle_users_command,
+      &EpollServer::handle_channel_message,
+      &EpollServer::handle_proto_command,
+      &EpollServer::handle_bigmsg_command,
+      &EpollServer::handle_stats_command,
+      &EpollServer::handle_history_command,
+      &EpollServer::handle_dm_command,
+      &EpollServer::handle_sendfile_command,
+      &EpollServer::handle_sendchunk_command,
+  };
+  size_t index = static_cast<size_t>(command);
+  auto start = std::chrono::steady_clock::now();
+  (this->*kHandlers[index])(client_sock, arg);
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  stats_.command_latency_ns[index].record(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+}
+
+void EpollServer::handle_invalid_command(int client_sock, std::string_view) {
+  send_message(client_sock, "Invalid Command.\n");
+  SPDLOG_WARN("Client {} entered an invalid command.", client_sock);
+}
+
+void EpollServer::handle_bigmsg_command(int client_sock, std::string_view arg) {
+  // Test helper: broadcasts a message of the requested number of 'a's.
+  int len = 0;
+  auto [end, ec] = std::from_chars(arg.data(), arg.data() + arg.size(), len);
+  if (ec != std::errc() || end != arg.data() + arg.size() || len < 0) {
+    handle_invalid_command(client_sock, arg);
+    return;
   }
+  handle_channel_message(client_sock, std::string(len, 'a'));
 }
 
-void EpollServer::handle_create_command(int client_sock, const std::string& new_channel_name) {
+void EpollServer::handle_stats_command(int client_sock, std::string_view arg) {
+  if (!config_.stats_command) {
+    handle_invalid_command(client_sock, arg);
+    return;
+  }
+  // Every shard's counters, read in place; see ServerStats::render_prometheus().
+  send_message(client_sock, group_.render_metrics());
+}
+
+void EpollServer::handle_history_command(int client_sock, std::string_view arg) {
+  size_t count = config_.history_size;
+  if (!arg.empty()) {
+    auto [end, ec] = std::from_chars(arg.data(), arg.data() + arg.size(), count);
+    if (ec != std::errc() || end != arg.data() + arg.size()) {
+      handle_invalid_command(client_sock, arg);
+      return;
+    }
+  }
+  const Connection& conn = *connections_.find(client_sock);
+  if (!conn.channel) {
+    send_message(client_sock, "You are not in a channel. Use /join first.\n");
+    return;
+  }
+  replay_history(client_sock, conn, count);
+}
+
+void EpollServer::replay_history(int client_sock, const Connection& conn, size_t max_frames) {
+  // Half the queue cap, so a replay can never trip the slow-consumer policy by itself.
+  std::vector<SharedFrame> frames =
+      conn.channel->history.recent(max_frames, static_cast<size_t>(config_.max_queued_bytes) / 2);
+  if (frames.empty()) {
+    return;
+  }
+  // History holds v1 frames. The batch is their concatenation, re-headed for a v2 client,
+  // queued as one frame so it goes out in one send instead of one per message.
+  bool v2 = conn.protocol == net::kProtocolV2;
+  size_t total = 0;
+  for (const SharedFrame& frame : frames) {
+    total += v2 ? frame->size() - net::kLengthPrefixSize + net::kV2HeaderSize : frame->size();
+  }
+  auto batch = std::make_shared<std::string>();
+  batch->reserve(total);
+  for (const SharedFrame& frame : frames) {
+    if (!v2) {
+      batch->append(*frame);
+      continue;
+    }
+    std::string_view body = std::string_view(*frame).substr(net::kLengthPrefixSize);
+    size_t at = batch->size();
+    batch->resize(at + net::kV2HeaderSize);
+    net::write_v2_header(batch->data() + at, net::Opcode::kChannelMessage, body.size());
+    batch->append(body);
+  }
+  stats_.history_replays++;
+  stats_.history_frames_replayed += frames.size();
+  send_frame(client_sock, std::move(batch), client_sock);
+}
+
+void EpollServer::handle_proto_command(int client_sock, std::string_view arg) {
+  Connection* conn = connections_.find(client_sock);
+  // "2 deflate" also asks for compression, granted unless --compress-threshold=0.
+  bool wants_compression = false;
+  if (size_t space = arg.find(' '); space != std::string_view::npos && arg.substr(0, space) == "2") {
+    wants_compression = arg.substr(space + 1) == net::kCompressionName;
+    if (wants_compression) arg = arg.substr(0, space);
+  }
+  if (arg != "1" && arg != "2") {
+    send_message(client_sock, "Unsupported protocol version.\n");
+    SPDLOG_WARN("Client {} requested unsupported protocol '{}'.", client_sock, arg);
+    return;
+  }
+  int version = arg == "2" ? net::kProtocolV2 : net::kProtocolV1;
+  bool compress = wants_compression && config_.compress_threshold > 0;
+  // The answer still goes out in the old framing; the next frame in either direction
+  // uses the new one.
+  send_message(client_sock, "Protocol " + std::string(arg) +
+                                (compress ? " enabled (" + std::string(net::kCompressionName) + ").\n" : " enabled.\n"));
+  conn->protocol = version;
+  conn->compress = compress;
+  conn->decoder.set_version(version);
+  SPDLOG_INFO("Client {} switched to protocol {}{}.", client_sock, version, compress ? " with compression" : "");
+}
+
+void EpollServer::handle_create_command(int client_sock, std::string_view arg) {
+  std::string new_channel_name(arg);
   if(new_channel_name.empty()) {
     send_message(client_sock, "Empty channel names are not allowed.\n");
     SPDLOG_WARN("Client {} attempted to create an empty channel name.", client_sock);
     return;
   }
-  if (channel_mgr_->has_channel(new_channel_name)) {
+  if (new_channel_name.size() > kMaxChannelNameLength) {
+    send_message(client_sock, "Channel names are limited to " + std::to_string(kMaxChannelNameLength) + " bytes.\n");
+    SPDLOG_WARN("Client {} attempted to create a {}-byte channel name.", client_sock, new_channel_name.size());
+    return;
+  }
+  ChannelEntry* channel = group_.directory().create_channel(new_channel_name);
+  if (!channel) {
     send_message(client_sock, "Duplicate channel names are not allowed.\n");
     SPDLOG_WARN("Client {} attempted to create a duplicate channel name.", client_sock);
     return;
   }
-  channel_mgr_->create_channel(new_channel_name);
-  if(client_channels_.find(client_sock) != client_channels_.end()) {
-    channel_mgr_->join_channel(new_channel_name, client_channels_[client_sock], client_sock);
-  }
-  else {
-    channel_mgr_->join_channel(new_channel_name, "", client_sock);
-  }
-  client_channels_[client_sock] = new_channel_name;
+  move_to_channel(client_sock, channel);
   send_message(client_sock, "Channel created.\n");
   SPDLOG_INFO("Channel created.\n");
 }
 
-void EpollServer::handle_join_command(int client_sock, const std::string& new_channel_name) {
-  if (!channel_mgr_->has_channel(new_channel_name)) {
+void EpollServer::handle_join_command(int client_sock, std::string_view arg) {
+  std::string new_channel_name(arg);
+  ChannelEntry* channel = group_.directory().find_channel(new_channel_name);
+  if (!channel) {
     send_message(client_sock, "Channel not found.\n");
     SPDLOG_WARN("Client {} attempted to join a nonexisting channel.", client_sock);
     return;
   }
-  if(client_channels_.find(client_sock) != client_channels_.end()) {
-    channel_mgr_->join_channel(new_channel_name, client_channels_[client_sock], client_sock);
-  }
-  else {
-    channel_mgr_->join_channel(new_channel_name, "", client_sock);
-  }
-  client_channels_[client_sock] = new_channel_name;
+  move_to_channel(client_sock, channel);
   send_message(client_sock, "Joined channel.\n");
+  if (config_.history_on_join > 0) {
+    replay_history(client_sock, *connections_.find(client_sock), config_.history_on_join);
+  }
   SPDLOG_INFO("Client {} joined channel '{}'.", client_sock, new_channel_name);
 }
 
-void EpollServer::handle_list_command(int client_sock) {
-  auto list = channel_mgr_->list_channels();
+void EpollServer::handle_list_command(int client_sock, std::string_view) {
+  auto list = group_.directory().list_channels();
   std::string out = "Channels:\n";
   for (auto &ch : list) out += "- " + ch + "\n";
   send_message(client_sock, out.c_str());
   SPDLOG_INFO("Channels listed.");
 }
 
-void EpollServer::handle_users_command(int client_sock) {
+void EpollServer::handle_users_command(int client_sock, std::string_view) {
   // "/users non_empty" will not throw an error
-  std::string ch = client_channels_[client_sock];
-  std::string list = "Users in [" + ch + "]:\n";
-  for (int fd : channel_mgr_->get_members(ch)) {
-      list += "- " + usernames_[fd] + "\n";
+  ChannelEntry* channel = connections_.find(client_sock)->channel;
+  std::string_view ch = channel ? std::string_view(channel->name) : std::string_view();
+  std::string list = "Users in [" + std::string(ch) + "]:\n";
+  if (channel) {
+    for (const auto& name : group_.directory().member_names(channel)) {
+      list += "- " + name + "\n";
+    }
   }
   send_message(client_sock, list.c_str());
   SPDLOG_INFO("Users in channel '{}' listed.",ch);
 }
 
-void EpollServer::handle_channel_message(int client_sock, const std::string& msg_content) {
-  std::string ch = client_channels_[client_sock];
-  if (ch.empty()) {
+void EpollServer::handle_channel_message(int client_sock, std::string_view msg_content) {
+  // One table access; name and channel are read in place, not copied.
+  const Connection& conn = *connections_.find(client_sock);
+  if (!conn.channel) {
     send_message(client_sock, "You are not in a channel. Use /join first.\n");
     SPDLOG_WARN("User {} attempted to send a message without being in a channel",client_sock);
     return;
   }
-  std::string uname;
-  if(usernames_.count(client_sock)) {
-    uname = usernames_[client_sock];
+  const std::string& ch = conn.channel->name;
+  // "[channel] user: text" is laid out straight into the outgoing frame, header
+  // included; there is no intermediate string.
+  FrameBuilder body;
+  body.append("[").append(ch).append("] ").append(conn.name).append(": ").append(msg_content);
+  broadcast_to_channel(conn.channel, body, client_sock);
+  HOT_LOG_INFO("User {} sent message on channel '{}'",client_sock,ch);
+}
+
+void EpollServer::handle_dm_command(int client_sock, std::string_view arg) {
+  // "@user text" (the '@' is optional). A DM is one index lookup and one queued frame:
+  // no channel, no fan-out, no directory lock.
+  size_t name_end = arg.find_first_of(" \t");
+  std::string_view target = arg.substr(0, name_end);
+  if (!target.empty() && target.front() == '@') {
+    target.remove_prefix(1);
+  }
+  std::string_view text;
+  if (name_end != std::string_view::npos) {
+    text = arg.substr(name_end);
+    text.remove_prefix(std::min(text.find_first_not_of(" \t"), text.size()));
+  }
+  if (target.empty() || text.empty()) {
+    send_message(client_sock, "Usage: /dm @user <message>\n");
+    return;
+  }
+  std::optional<UserLocation> where = group_.directory().find_user(target);
+  const Connection& conn = *connections_.find(client_sock);
+  FanoutFrames frames{FrameBuilder(), nullptr, nullptr, net::Opcode::kDirectMessage};
+  frames.body.append("[DM] ").append(conn.name).append(": ").append(text);
+  if (!where || !send_to_user(*where, frames, client_sock)) {
+    stats_.dms_undeliverable++;
+    send_message(client_sock, "User not found.\n");
+    return;
   }
-  else {
-    uname = client_usernames_[client_sock];
+  if (where->shard != shard_id_) {
+    stats_.dms_forwarded++;
+  } else {
+    stats_.dms_sent++;
+  }
+  HOT_LOG_INFO("User {} sent a direct message to '{}'", client_sock, target);
+}
+
+bool EpollServer::send_to_user(const UserLocation& where, FanoutFrames& frames, int origin_fd) {
+  if (where.shard != shard_id_) {
+    // The recipient's shard checks the conn_id, in case it left in the meantime.
+    push_to_shard(where.shard, CrossShardMessage{nullptr, fanout_frame(frames, net::kProtocolV1), where.fd,
+                                                 where.conn_id, frames.opcode, frames.transfer});
+    return true;
+  }
+  return deliver_to_client(where.fd, where.conn_id, frames, origin_fd);
+}
+
+bool EpollServer::deliver_to_client(int fd, std::uint64_t conn_id, FanoutFrames& frames, int origin_fd) {
+  Connection* conn = connections_.find(fd);
+  if (!conn || conn->conn_id != conn_id) {
+    return false;
   }
-  std::string full_msg = "[" + ch + "] " + uname + ": " + msg_content;
-  broadcast_to_channel(ch, full_msg, client_sock);
-  SPDLOG_INFO("User {} sent message on channel '{}'",client_sock,ch);
+  send_frame(fd, fanout_frame(frames, *conn), origin_fd);
+  return true;
 }
 
-void EpollServer::broadcast_to_channel(const std::string &channel, const std::string &msg, int sender_fd) {
-  for (int fd : channel_mgr_->get_members(channel)) {
-    if (fd != sender_fd) {
-      send_message(fd, msg.c_str());
+void EpollServer::handle_sendfile_command(int client_sock, std::string_view arg) {
+  // "[@user] <name> <size>": the client streams exactly <size> bytes of /sendchunk
+  // frames next. Without a user the file goes to the sender's channel.
+  std::string_view target;
+  if (!arg.empty() && arg.front() == '@') {
+    size_t target_end = std::min(arg.find_first_of(" \t"), arg.size());
+    target = arg.substr(1, target_end - 1);
+    arg.remove_prefix(target_end);
+  }
+  size_t size_start = arg.find_last_of(" \t");
+  std::string_view name;
+  std::uint64_t size = 0;
+  if (size_start != std::string_view::npos) {
+    name = arg.substr(0, size_start);
+    name.remove_prefix(std::min(name.find_first_not_of(" \t"), name.size()));
+    std::string_view size_text = arg.substr(size_start + 1);
+    auto [end, ec] = std::from_chars(size_text.data(), size_text.data() + size_text.size(), size);
+    if (ec != std::errc() || end != size_text.data() + size_text.size()) {
+      name = {};
+    }
+  }
+  Connection& conn = *connections_.find(client_sock);
+  if (name.empty()) {
+    send_message(client_sock, "Usage: /sendfile [@user] <name> <size>\n");
+    return;
+  }
+  if (conn.upload) {
+    send_message(client_sock, "A file transfer is already in progress.\n");
+    return;
+  }
+
+  // Resolve the target first, so a rejected upload allocates nothing and uses no id.
+  std::optional<UserLocation> where;
+  if (target.empty()) {
+    if (!conn.channel) {
+      send_message(client_sock, "You are not in a channel. Use /join first.\n");
+      return;
+    }
+  } else {
+    where = group_.directory().find_user(target);
+    if (!where) {
+      send_message(client_sock, "User not found.\n");
+      return;
     }
   }
+
+  // Ids only need to be unique across the server: the shard index in the low bits.
+  std::uint64_t id = ++uploads_started_ * kMaxShards + shard_id_;
+  auto upload = std::make_shared<FileTransfer>(id, std::string(name), size,
+                                               static_cast<size_t>(config_.file_window_bytes),
+                                               group_.mailbox(shard_id_));
+  if (where) {
+    upload->user = *where;
+  } else {
+    upload->channel = conn.channel;
+  }
+  conn.upload = upload;
+  stats_.files_started++;
+
+  std::string header = "[FILE " + std::to_string(id) + " " + std::to_string(size) + "] ";
+  FanoutFrames frames{FrameBuilder(), nullptr, nullptr, net::Opcode::kFileStart};
+  frames.body.append(header).append(conn.name).append(": ").append(upload->name);
+  relay_upload(*upload, frames, client_sock);
+  send_message(client_sock, "Sending file " + std::to_string(id) + ".\n");
+  SPDLOG_INFO("Client {} started file {} '{}' ({} bytes)", client_sock, id, upload->name, size);
+  if (size == 0) {
+    finish_upload(client_sock, conn, true);
+  }
 }
 
-void EpollServer::run() {
+void EpollServer::handle_sendchunk_command(int client_sock, std::string_view arg) {
+  Connection& conn = *connections_.find(client_sock);
+  if (!conn.upload) {
+    // The rest of an upload that was refused or cut short; one reply was enough.
+    stats_.file_chunks_dropped++;
+    return;
+  }
+  // Keeps the transfer alive even if finish_upload() drops the connection's reference.
+  std::shared_ptr<FileTransfer> upload = conn.upload;
+  if (arg.size() > upload->size - upload->received) {
+    send_message(client_sock, "File chunk exceeds the announced size.\n");
+    finish_upload(client_sock, conn, false);
+    return;
+  }
+  // One copy, from the receive buffer into the shared frame(s); none per recipient.
+  FanoutFrames frames{FrameBuilder(upload->chunk_prefix), nullptr, nullptr, net::Opcode::kFileData, upload};
+  frames.body.append(arg);
+  relay_upload(*upload, frames, client_sock);
+  upload->received += arg.size();
+  stats_.file_chunks_relayed++;
+  stats_.file_bytes_relayed += arg.size();
+  if (upload->received == upload->size) {
+    finish_upload(client_sock, conn, true);
+  } else if (upload->should_pause()) {
+    // Frames still in this function's FanoutFrames count too; they go on return.
+    stats_.file_window_pauses++;
+    window_paused_.emplace_back(client_sock, conn.conn_id);
+    pause_reads(client_sock);
+  }
+}
+
+void EpollServer::relay_upload(const FileTransfer& upload, FanoutFrames& frames, int sender_fd) {
+  if (upload.channel) {
+    deliver_local(upload.channel, frames, sender_fd);
+    forward_to_shards(upload.channel, frames);
+  } else {
+    send_to_user(upload.user, frames, sender_fd);
+  }
+}
+
+void EpollServer::finish_upload(int client_sock, Connection& conn, bool complete) {
+  std::shared_ptr<FileTransfer> upload = std::move(conn.upload);
+  conn.upload.reset();
+  std::string end = "[FILE " + std::to_string(upload->id) + (complete ? " done]" : " aborted]");
+  FanoutFrames frames{FrameBuilder(end), nullptr, nullptr, net::Opcode::kFileEnd};
+  relay_upload(*upload, frames, client_sock);
+  if (complete) {
+    stats_.files_completed++;
+    send_message(client_sock, "File " + std::to_string(upload->id) + " sent.\n");
+  } else {
+    stats_.files_aborted++;
+  }
+  if (upload->paused.exchange(false)) {
+    std::pair<int, std::uint64_t> sender{client_sock, conn.conn_id};
+    window_paused_.erase(std::remove(window_paused_.begin(), window_paused_.end(), sender),
+                         window_paused_.end());
+    resume_reads(client_sock);
+  }
+  SPDLOG_INFO("Client {} {} file {} ({} of {} bytes)", client_sock, complete ? "finished" : "aborted",
+              upload->id, upload->received, upload->size);
+}
+
+void EpollServer::resume_uploads() {
+  for (size_t i = 0; i < window_paused_.size();) {
+    auto [fd, conn_id] = window_paused_[i];
+    Connection* conn = connections_.find(fd);
+    bool live = conn && conn->conn_id == conn_id && conn->upload;
+    if (live && !conn->upload->drained()) {
+      ++i;
+      continue;
+    }
+    window_paused_[i] = window_paused_.back();
+    window_paused_.pop_back();
+    if (live) {
+      conn->upload->paused.store(false);
+      resume_reads(fd);
+    }
+  }
+}
+
+void EpollServer::broadcast_to_channel(ChannelEntry* channel, const FrameBuilder& body, int sender_fd) {
+  // Encoded at most once per protocol; every recipient's send, on this shard or another,
+  // references the same buffer, so per-member cost is a reference count, not a format.
+  FanoutFrames frames{body, nullptr, nullptr};
+  if (message_log_) {
+    // The log records the body as it goes out in v1, which is also what history and
+    // other shards use, so this encoding is never wasted.
+    const SharedFrame& v1 = fanout_frame(frames, net::kProtocolV1);
+    message_log_->append(channel->name, std::string_view(*v1).substr(net::kLengthPrefixSize));
+    stats_.log_records++;
+    if (message_log_->durability() != Durability::kNone) {
+      pending_broadcasts_.push_back({channel, v1, sender_fd, connections_.find(sender_fd)->conn_id});
+      return;
+    }
+  }
+  deliver_broadcast(channel, frames, sender_fd);
+}
+
+void EpollServer::deliver_broadcast(ChannelEntry* channel, FanoutFrames& frames, int sender_fd) {
+  deliver_local(channel, frames, sender_fd);
+  forward_to_shards(channel, frames);
+  if (config_.history_size > 0) {
+    channel->history.push(fanout_frame(frames, net::kProtocolV1), config_.history_size,
+                          group_.history_budget());
+  }
+}
+
+void EpollServer::commit_message_log() {
+  while (message_log_ && message_log_->ready_to_commit()) {
+    log_commit_records_ = message_log_->begin_commit();
+    log_commit_failed_ = false;
+    log_commit_start_ = std::chrono::steady_clock::now();
+    stats_.log_commits++;
+    stats_.log_bytes += message_log_->commit_data().size();
+    stats_.log_batch_records.record(log_commit_records_);
+    if (message_log_->commit_needs_sync()) {
+      stats_.log_syncs++;
+    }
+    #ifdef IO_URING_ENABLED
+      // Write and fsync go in as one linked chain, so both SQEs must land in the same
+      // submission; the fsync's CQE (or the write's, with no fsync) completes the batch.
+      // One batch at a time keeps the file offsets simple and is what turns a burst of
+      // messages into one fsync.
+      bool sync = message_log_->commit_needs_sync();
+      if (io_uring_sq_space_left(&ring_) < 2) {
+        flush_submissions();
+      }
+      io_uring_sqe* write_sqe = io_uring_get_sqe(&ring_);
+      io_uring_sqe* fsync_sqe = write_sqe && sync ? io_uring_get_sqe(&ring_) : nullptr;
+      if (!write_sqe || (sync && !fsync_sqe)) {
+        if (write_sqe) {
+          io_uring_prep_nop(write_sqe);
+          io_uring_sqe_set_data(write_sqe, nullptr);
+        }
+        on_log_committed(message_log_->write_sync());
+        continue;
+      }
+      const std::string& data = message_log_->commit_data();
+      io_uring_prep_write(write_sqe, message_log_->commit_fd(), data.data(), data.size(),
+                          message_log_->commit_offset());
+      io_uring_sqe_set_data(write_sqe, new_context(IO_LOG_WRITE, message_log_->commit_fd()));
+      if (sync) {
+        write_sqe->flags |= IOSQE_IO_LINK;
+        io_uring_prep_fsync(fsync_sqe, message_log_->commit_fd(), IORING_FSYNC_DATASYNC);
+        io_uring_sqe_set_data(fsync_sqe, new_context(IO_LOG_FSYNC, message_log_->commit_fd()));
+      }
+      return;
+    #else
+      on_log_committed(message_log_->write_sync());
+    #endif
+  }
+}
+
+void EpollServer::on_log_committed(bool ok) {
+  auto elapsed = std::chrono::steady_clock::now() - log_commit_start_;
+  stats_.log_commit_latency_us.record(
+      std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count());
+  if (!ok) {
+    SPDLOG_ERROR("Message log write failed (shard {}): {}", shard_id_, strerror(errno));
+  }
+  message_log_->end_commit();
+  if (message_log_->durability() == Durability::kNone) {
+    return;
+  }
+  // Delivered even if the write failed: the log is lost for these, the chat is not.
+  for (size_t i = 0; i < log_commit_records_ && !pending_broadcasts_.empty(); ++i) {
+    PendingBroadcast pending = std::move(pending_broadcasts_.front());
+    pending_broadcasts_.pop_front();
+    Connection* sender = connections_.find(pending.sender_fd);
+    int sender_fd = sender && sender->conn_id == pending.sender_conn_id ? pending.sender_fd : -1;
+    FanoutFrames frames{FrameBuilder(std::string_view(*pending.frame).substr(net::kLengthPrefixSize)),
+                        pending.frame, nullptr};
+    deliver_broadcast(pending.channel, frames, sender_fd);
+  }
+}
+
+void EpollServer::finish_message_log() {
+  if (!message_log_) {
+    return;
+  }
   #ifdef IO_URING_ENABLED
-    SPDLOG_INFO("Server started with IO_URING");
-    while(true){
+    while (message_log_->committing()) {
+      int ret = io_uring_submit_and_wait(&ring_, 1);
+      if (ret < 0 && ret != -EINTR) break;
       handle_io_uring_events();
     }
+  #endif
+  while (message_log_->ready_to_commit()) {
+    log_commit_records_ = message_log_->begin_commit();
+    log_commit_start_ = std::chrono::steady_clock::now();
+    on_log_committed(message_log_->write_sync());
+  }
+}
+
+const SharedFrame& EpollServer::fanout_frame(FanoutFrames& frames, int protocol) {
+  SharedFrame& frame = protocol == net::kProtocolV2 ? frames.v2 : frames.v1;
+  if (!frame) {
+    frame = encode_frame(frames.body, protocol, frames.opcode);
+    if (frames.transfer) {
+      frame = FileTransfer::track(frames.transfer, std::move(frame));
+    }
+  }
+  return frame;
+}
+
+const SharedFrame& EpollServer::fanout_frame(FanoutFrames& frames, const Connection& conn) {
+  if (!conn.compress || frames.body.body_size() < static_cast<size_t>(config_.compress_threshold) ||
+      (frames.transfer && frames.transfer->incompressible.load(std::memory_order_relaxed))) {
+    return fanout_frame(frames, conn.protocol);
+  }
+  // Tried once per broadcast, on the first compressing member. A body that does not
+  // shrink leaves v2z pointing at the plain v2 frame, so it is not tried again.
+  if (!frames.v2z) {
+    frames.v2z = compress_frame(frames.body, frames.opcode);
+    if (!frames.v2z) {
+      if (frames.transfer) frames.transfer->incompressible.store(true, std::memory_order_relaxed);
+      frames.v2z = fanout_frame(frames, net::kProtocolV2);
+    } else if (frames.transfer) {
+      frames.v2z = FileTransfer::track(frames.transfer, std::move(frames.v2z));
+    }
+  }
+  if (frames.v2z != frames.v2) {
+    stats_.compress_wire_bytes_saved += net::kV2HeaderSize + frames.body.body_size() - frames.v2z->size();
+  }
+  return frames.v2z;
+}
+
+SharedFrame EpollServer::compress_frame(const FrameBuilder& body, net::Opcode opcode) {
+  auto start = std::chrono::steady_clock::now();
+  bool smaller = compressor_.compress(body.pieces(), compress_buf_);
+  auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+  stats_.compress_ns += ns;
+  stats_.compress_latency_ns.record(ns);
+  if (!smaller) {
+    stats_.compress_skipped++;
+    return nullptr;
+  }
+  stats_.frames_compressed++;
+  stats_.compress_bytes_in += body.body_size();
+  stats_.compress_bytes_out += compress_buf_.size();
+  stats_.frames_encoded++;
+  stats_.bytes_encoded += net::kV2HeaderSize + compress_buf_.size();
+  auto frame = std::make_shared<std::string>(net::kV2HeaderSize, '\0');
+  net::write_v2_header(frame->data(), opcode, compress_buf_.size(), net::kFlagCompressed);
+  frame->append(compress_buf_);
+  return frame;
+}
+
+void EpollServer::deliver_local(ChannelEntry* channel, FanoutFrames& frames, int sender_fd) {
+  // send_frame() never removes members (teardown is left to the recv side), so the
+  // span stays valid for the whole scan.
+  std::uint64_t recipients = 0;
+  for (int fd : channel_mgr_->members(channel->id)) {
+    if (fd == sender_fd) continue;
+    if (Connection* conn = connections_.find(fd)) {
+      send_frame(fd, fanout_frame(frames, *conn), sender_fd);
+      ++recipients;
+    }
+  }
+  stats_.fanout_size.record(recipients);
+}
+
+void EpollServer::forward_to_shards(ChannelEntry* channel, FanoutFrames& frames) {
+  std::uint64_t mask = channel->shard_mask.load(std::memory_order_acquire);
+  mask &= ~(std::uint64_t{1} << shard_id_);
+  while (mask) {
+    int shard = __builtin_ctzll(mask);
+    mask &= mask - 1;
+    // Shards exchange the v1 frame; the receiver derives a v2 frame from its body if
+    // it has v2 members.
+    push_to_shard(shard, CrossShardMessage{channel, fanout_frame(frames, net::kProtocolV1), -1, 0,
+                                           frames.opcode, frames.transfer});
+    stats_.cross_shard_forwarded++;
+  }
+}
+
+void EpollServer::push_to_shard(int shard, const CrossShardMessage& msg) {
+  ShardMailbox& mailbox = group_.mailbox(shard);
+  while (!mailbox.try_push(shard_id_, msg)) {
+    // Peer is behind: wake it and keep our own inbox moving meanwhile, so two shards
+    // flooding each other cannot both wait forever. Delivery never forwards again.
+    stats_.mailbox_full_waits++;
+    mailbox.notify();
+    drain_mailbox();
+    std::this_thread::yield();
+  }
+  doorbells_ |= std::uint64_t{1} << shard;
+}
+
+void EpollServer::drain_mailbox() {
+  stats_.cross_shard_delivered += group_.mailbox(shard_id_).drain([this](const CrossShardMessage& msg) {
+    FrameBuilder body(std::string_view(*msg.frame).substr(net::kLengthPrefixSize));
+    FanoutFrames frames{body, msg.frame, nullptr, msg.opcode, msg.transfer};
+    if (msg.channel) {
+      deliver_local(msg.channel, frames, -1);
+      return;
+    }
+    bool delivered = deliver_to_client(msg.target_fd, msg.target_conn_id, frames, -1);
+    if (msg.opcode == net::Opcode::kDirectMessage) {
+      if (delivered) {
+        stats_.dms_sent++;
+      } else {
+        stats_.dms_undeliverable++;
+      }
+    }
+  });
+  // Releases on any shard may have drained an upload window; they ring this mailbox.
+  if (!window_paused_.empty()) {
+    resume_uploads();
+  }
+}
+
+void EpollServer::ring_doorbells() {
+  while (doorbells_) {
+    int shard = __builtin_ctzll(doorbells_);
+    doorbells_ &= doorbells_ - 1;
+    group_.mailbox(shard).notify();
+  }
+}
+
+SharedFrame EpollServer::encode_frame(const FrameBuilder& body, int protocol, net::Opcode opcode) {
+  stats_.frames_encoded++;
+  stats_.bytes_encoded += FrameBuilder::header_size(protocol) + body.body_size();
+  return body.build(protocol, opcode);
+}
+
+void EpollServer::run() {
+  HotLog::attach(shard_id_);
+  #ifdef IO_URING_ENABLED
+    SPDLOG_INFO("Server started with IO_URING ({} recv, shard {}/{})",
+                multishot_ ? "multishot" : "single-shot", shard_id_, group_.size());
+    while (!stop_requested_.load(std::memory_order_relaxed)) {
+      wait_and_process_events();
+    }
   #else
-    SPDLOG_INFO("Server started with epoll");
+    SPDLOG_INFO("Server started with epoll (shard {}/{})", shard_id_, group_.size());
     epoll_event events[kMaxEvents];
     handle_epoll_events(events);
   #endif
+  SPDLOG_INFO("Server stopping (shard {}).", shard_id_);
+  finish_message_log();
+  #ifdef IO_URING_ENABLED
+    stats_.contexts_in_use = ctx_pool_.in_use();
+    stats_.context_slabs = ctx_pool_.slabs();
+    stats_.recv_buffer_slabs = recv_buffer_pool_.slabs();
+  #endif
+  stats_.spin_hits = spin_.hits();
+  stats_.spin_misses = spin_.misses();
+  stats_.log_summary(heap_allocations());
+  if (shard_id_ == 0 && config_.history_size > 0) {
+    const HistoryBudget& budget = group_.history_budget();
+    SPDLOG_INFO("History stats: bytes={} budget_bytes={} frames={} rejected={}",
+                budget.used(), budget.limit(), budget.frames(), budget.rejected());
+  }
 }
 
-int EpollServer::send_message(int client_sock, const char* msg, size_t len, int flags) {
-    size_t total_sent = 0;
-    
-    ssize_t sent = send(client_sock, msg + total_sent, len - total_sent, flags);
-    if (sent < 0) {
-        if (errno == EINTR) return 0; 
-        SPDLOG_ERROR("Failed to send to client {}: {} (errno: {})", client_sock, strerror(errno), errno);
-        return -1;
-    }
-    if (sent == 0) { 
-        SPDLOG_WARN("Client {} disconnected during send (0 bytes sent). Disconnecting.", client_sock);
-        return 0;
+int EpollServer::send_message(int client_sock, const std::string& message) {
+  // Replies are produced by the client's own input, so that is who a pause would hold.
+  Connection* conn = connections_.find(client_sock);
+  if (!conn) {
+    return -1;
+  }
+  FanoutFrames frames{FrameBuilder(message), nullptr, nullptr, net::Opcode::kReply};
+  return send_frame(client_sock, fanout_frame(frames, *conn), client_sock);
+}
+
+int EpollServer::send_frame(int client_sock, const SharedFrame& frame, int origin_fd) {
+  Connection* found = connections_.find(client_sock);
+  if (!found || found->closing) {
+    return -1;
+  }
+  Connection& conn = *found;
+  if (conn.out.bytes() + frame->size() > static_cast<size_t>(config_.max_queued_bytes) &&
+      !admit_over_cap(client_sock, conn, frame->size(), origin_fd)) {
+    return -1;
+  }
+
+  stats_.frames_sent++;
+  stats_.queued_bytes += frame->size();
+  conn.out.push(frame);
+  conn.frames_out++;
+  stats_.peak_queued_bytes = std::max<std::uint64_t>(stats_.peak_queued_bytes, conn.out.bytes());
+  stats_.peak_queued_frames = std::max<std::uint64_t>(stats_.peak_queued_frames, conn.out.frames());
+  stats_.send_queue_depth.record(conn.out.bytes());
+  if (config_.coalesce_sends) {
+    schedule_flush(client_sock, conn);
+  } else {
+    flush_outbound(client_sock, conn);
+  }
+  return frame->size();
+}
+
+void EpollServer::schedule_flush(int client_sock, Connection& conn) {
+  // A send in flight takes the new frame along when it completes (io_uring), and a
+  // queue that already fills a batch gains nothing from waiting.
+  if (conn.out.in_flight()) return;
+  if (conn.out.frames() >= OutboundQueue::kMaxGather) {
+    flush_outbound(client_sock, conn);
+    return;
+  }
+  if (conn.flush_scheduled) return;
+  conn.flush_scheduled = true;
+  // Without a budget every entry is due at the end of this iteration; the clock is
+  // only read when there is a deadline to keep.
+  std::chrono::steady_clock::time_point due{};
+  if (config_.coalesce_us > 0) {
+    due = std::chrono::steady_clock::now() + std::chrono::microseconds(config_.coalesce_us);
+  }
+  pending_flushes_.push_back({client_sock, conn.conn_id, due});
+}
+
+void EpollServer::flush_due_clients() {
+  if (pending_flushes_.empty()) return;
+  std::chrono::steady_clock::time_point now{};
+  if (config_.coalesce_us > 0) {
+    now = std::chrono::steady_clock::now();
+  }
+  // Entries are in scheduling order, and all share one budget, so they fall due in order.
+  while (!pending_flushes_.empty() && pending_flushes_.front().due <= now) {
+    PendingFlush next = pending_flushes_.front();
+    pending_flushes_.pop_front();
+    Connection* conn = connections_.find(next.fd);
+    if (!conn || conn->conn_id != next.conn_id) {
+      continue; // gone; the fd may belong to someone else by now
     }
-    total_sent += sent;
-    
-    return total_sent;
+    conn->flush_scheduled = false;
+    flush_outbound(next.fd, *conn);
+  }
 }
 
-int EpollServer::send_message(int client_sock, const std::string& message) {
-  std::string msg_sz_str = std::to_string(message.size());
-  if (msg_sz_str.length() > 20) {
-      SPDLOG_ERROR("Message size ({}) exceeds {}-character length prefix limit for client {}. This message might be truncated at receiver.",
-                   message.size(), 20, client_sock);
-      msg_sz_str = msg_sz_str.substr(msg_sz_str.length() - 20);
+std::int64_t EpollServer::flush_wait_ns() const {
+  if (pending_flushes_.empty()) return -1;
+  auto wait = pending_flushes_.front().due - std::chrono::steady_clock::now();
+  return std::max<std::int64_t>(0, std::chrono::duration_cast<std::chrono::nanoseconds>(wait).count());
+}
+
+bool EpollServer::admit_over_cap(int client_sock, Connection& conn, size_t frame_size, int origin_fd) {
+  switch (config_.slow_consumer) {
+    case SlowConsumerPolicy::kDropOldest: {
+      size_t before = conn.out.bytes();
+      size_t dropped = conn.out.drop_oldest(frame_size, config_.max_queued_bytes);
+      stats_.frames_dropped += dropped;
+      stats_.queued_bytes -= before - conn.out.bytes();
+      return true;
+    }
+    case SlowConsumerPolicy::kDisconnect:
+      SPDLOG_WARN("Client {} has {} bytes queued, disconnecting slow consumer",
+                  client_sock, conn.out.bytes());
+      stats_.slow_consumer_disconnects++;
+      kick_client(client_sock, conn);
+      return false;
+    case SlowConsumerPolicy::kPause: {
+      // Nothing is lost: the frame is queued over the cap and the producer waits.
+      Connection* origin = connections_.find(origin_fd);
+      if (!origin) return true;
+      std::pair<int, std::uint64_t> sender{origin_fd, origin->conn_id};
+      if (std::find(conn.paused_senders.begin(), conn.paused_senders.end(), sender) ==
+          conn.paused_senders.end()) {
+        conn.paused_senders.push_back(sender);
+        pause_reads(origin_fd);
+      }
+      return true;
+    }
   }
-  msg_sz_str = std::string(20 - msg_sz_str.length(), '0') + msg_sz_str;
+  return true;
+}
 
-  int bytes_sent_len = send_message(client_sock, msg_sz_str.c_str(), msg_sz_str.length(), 0);
-  if (bytes_sent_len <= 0 || (size_t)bytes_sent_len != msg_sz_str.length()) {
-      SPDLOG_ERROR("Failed to send full length prefix to client {}. Sent: {} (expected {}). Disconnecting.",
-                   client_sock, bytes_sent_len, msg_sz_str.length());
-      return -1;
+void EpollServer::account_written(Connection& conn, size_t bytes, size_t requested) {
+  if (bytes < requested) {
+    stats_.partial_sends++;
+  }
+  conn.out.consume(bytes);
+  stats_.queued_bytes -= bytes;
+  stats_.bytes_sent += bytes;
+  // Hysteresis: let paused senders go once the queue is down to half the cap.
+  if (!conn.paused_senders.empty() &&
+      conn.out.bytes() <= static_cast<size_t>(config_.max_queued_bytes) / 2) {
+    release_paused_senders(conn);
   }
+}
+
+void EpollServer::fail_outbound(int client_sock, Connection& conn) {
+  // Whatever follows cannot be written in order any more; the recv side sees the same
+  // error or EOF and tears the connection down.
+  SPDLOG_WARN("Dropping {} queued bytes for client {}", conn.out.bytes(), client_sock);
+  stats_.queued_bytes -= conn.out.bytes();
+  conn.out.clear();
+  conn.closing = true;
+  release_paused_senders(conn);
+  #ifdef IO_URING_ENABLED
+    if (conn.parked_recv) {
+      continue_recv(std::exchange(conn.parked_recv, nullptr));
+    }
+  #else
+    update_epoll_events(client_sock, conn);
+  #endif
+}
+
+void EpollServer::kick_client(int client_sock, Connection& conn) {
+  fail_outbound(client_sock, conn);
+  // Shutting the socket down makes the pending recv complete with EOF, so teardown
+  // goes through the same single path as a client that hung up.
+  #ifdef IO_URING_ENABLED
+    auto* sqe = get_sqe();
+    if (!sqe) {
+      SPDLOG_ERROR("Failed to get SQE for shutting down client {}", client_sock);
+      return;
+    }
+    io_uring_prep_shutdown(sqe, client_sock, SHUT_RDWR);
+    mark_client_sqe(sqe);
+    io_uring_sqe_set_data(sqe, nullptr);
+  #else
+    shutdown(client_sock, SHUT_RDWR);
+  #endif
+}
+
+void EpollServer::pause_reads(int client_sock) {
+  Connection* conn = connections_.find(client_sock);
+  if (!conn || conn->read_pauses++ > 0) return;
+  stats_.read_pauses++;
+  SPDLOG_DEBUG("Pausing reads from client {}", client_sock);
+  #ifndef IO_URING_ENABLED
+    update_epoll_events(client_sock, *conn);
+  #endif
+  // io_uring: the recv is simply not re-armed after its next completion.
+}
 
-  int bytes_sent_msg = send_message(client_sock, message.c_str(), message.size(), 0);
-  if (bytes_sent_msg <= 0 || (size_t)bytes_sent_msg != message.size()) {
-      SPDLOG_ERROR("Failed to send full message body to client {}. Sent: {} (expected {}). Disconnecting.",
-                   client_sock, bytes_sent_msg, message.size());
-      return -1;
+void EpollServer::resume_reads(int client_sock) {
+  Connection* conn = connections_.find(client_sock);
+  if (!conn || --conn->read_pauses > 0) return;
+  SPDLOG_DEBUG("Resuming reads from client {}", client_sock);
+  #ifdef IO_URING_ENABLED
+    if (conn->parked_recv) {
+      continue_recv(std::exchange(conn->parked_recv, nullptr));
+    }
+  #else
+    update_epoll_events(client_sock, *conn);
+  #endif
+}
+
+void EpollServer::release_paused_senders(Connection& conn) {
+  auto senders = std::move(conn.paused_senders);
+  conn.paused_senders.clear();
+  for (auto [fd, conn_id] : senders) {
+    Connection* sender = connections_.find(fd);
+    if (sender && sender->conn_id == conn_id) {
+      resume_reads(fd);
+    }
   }
-  return bytes_sent_msg;
+}
+
+void EpollServer::flush_outbound(int client_sock, Connection& conn) {
+  #ifdef IO_URING_ENABLED
+    if (conn.out.empty() || conn.out.in_flight() || conn.closing) return;
+    // Everything queued leaves in one SENDMSG, except a front frame big enough for a
+    // zero-copy send, which goes alone.
+    size_t frames = 0;
+    if (conn.out.frames() > 1 &&
+        !(zero_copy_send_ && conn.out.pending_size() >= static_cast<size_t>(config_.zc_threshold))) {
+      frames = submit_sendmsg(client_sock, conn);
+    } else if (submit_send(client_sock, conn.out.front(), conn.out.front_offset(), conn.conn_id)) {
+      frames = 1;
+    }
+    conn.out.set_in_flight(frames);
+  #else
+    while (!conn.out.empty()) {
+      iovec iov[OutboundQueue::kMaxGather];
+      size_t requested = 0;
+      msghdr msg{};
+      msg.msg_iov = iov;
+      msg.msg_iovlen = conn.out.gather(iov, OutboundQueue::kMaxGather, requested);
+      ssize_t sent = sendmsg(client_sock, &msg, MSG_DONTWAIT | MSG_NOSIGNAL);
+      stats_.syscalls++;
+      stats_.send_calls++;
+      if (sent < 0) {
+        if (errno == EINTR) continue;
+        if (errno == EAGAIN || errno == EWOULDBLOCK) break; // EPOLLOUT resumes it
+        SPDLOG_ERROR("Failed to send to client {}: {}", client_sock, strerror(errno));
+        fail_outbound(client_sock, conn);
+        return;
+      }
+      stats_.frames_per_send.record(msg.msg_iovlen);
+      account_written(conn, sent, requested);
+    }
+    update_epoll_events(client_sock, conn);
+  #endif
 }
 
 }
@@ -1,14 +1,32 @@
 #ifndef EPOLL_SERVER_H
 #define EPOLL_SERVER_H
 
-#include <unordered_map>
-#include <unordered_set>
 #include <memory>
 #include <netinet/in.h>
 #include <sys/epoll.h>
+#include <sys/socket.h>
 #include <string>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <utility>
+#include <vector>
 #include <liburing.h>
 
+#include "server-config.h"
+#include "server-stats.h"
+#include "shared-frame.h"
+#include "outbound-queue.h"
+#include "connection.h"
+#include "shard-group.h"
+#include "adaptive-spin.h"
+#include "slab-pool.h"
+#include "command-parser.h"
+#include "message-log.h"
+#include "file-transfer.h"
+#include "../net/compression.h"
+
 #ifdef IO_URING_ENABLED
     #define BACKLOG 10
     #define QUEUE_DEPTH 256
@@ -18,25 +36,42 @@
 // Updated enum for new protocol operations
 enum IoOpType {
   IO_ACCEPT,
-  IO_RECV_LENGTH,    // New: for reading 20-byte length prefix
-  IO_RECV_MESSAGE,   // New: for reading actual message content
-  IO_SEND_LENGTH,    // New: for sending 20-byte length prefix
-  IO_SEND_MESSAGE    // New: for sending actual message content
+  IO_RECV,           // Single-shot recv of whatever is available into the context buffer
+  IO_SEND,           // Send of a whole encoded frame (prefix + body)
+  IO_SEND_ZC,        // Zero-copy send; completes with a result CQE and a later notification CQE
+  IO_SENDMSG,        // Vectored send of several queued frames (ctx->batch)
+  IO_ACCEPT_MULTISHOT, // One armed accept that yields a CQE per connection
+  IO_RECV_MULTISHOT,   // One armed recv per client, data lands in the provided-buffer ring
+  IO_WAKEUP,           // Read on the shard's mailbox eventfd
+  IO_LOG_WRITE,        // Message log batch write
+  IO_LOG_FSYNC         // Message log fsync, linked after the write
+};
+
+// What an IO_SENDMSG points the kernel at: the msghdr and iovecs, read when the SQE is
+// submitted, and references that keep every gathered frame alive until it completes.
+struct SendBatch {
+  msghdr msg{};
+  iovec iov[tt::chat::server::OutboundQueue::kMaxGather];
+  tt::chat::server::SharedFrame frames[tt::chat::server::OutboundQueue::kMaxGather];
 };
 
+// Lives in the server's SlabPool, never on the heap per operation. Everything an op needs
+// besides large buffers is inline.
 struct IoUringContext {
   IoOpType op_type;
   int client_fd;
   char* buffer;
   size_t buffer_size;
-  sockaddr_in* client_addr;  // Only used for accept operations
-  socklen_t* addr_len;       // Only used for accept operations
+  sockaddr_in client_addr{};                 // Only used for single-shot accept
+  socklen_t addr_len = sizeof(sockaddr_in);  // Only used for single-shot accept
+  tt::chat::server::SharedFrame frame;  // Only used for sends: keeps the shared buffer alive
+  std::uint64_t conn_id = 0;            // Only used for sends: the connection the fd belonged to
+  SendBatch* batch = nullptr;           // Only used for IO_SENDMSG, from the server's pool
+  alignas(8) char inline_buf[16];       // Small payloads, e.g. the mailbox eventfd counter
   
   // Constructor for convenience
-  IoUringContext(IoOpType type, int fd, char* buf, size_t size, 
-                 sockaddr_in* addr = nullptr, socklen_t* len = nullptr)
-    : op_type(type), client_fd(fd), buffer(buf), buffer_size(size), 
-      client_addr(addr), addr_len(len) {}
+  IoUringContext(IoOpType type, int fd, char* buf = nullptr, size_t size = 0)
+    : op_type(type), client_fd(fd), buffer(buf), buffer_size(size) {}
 };
 
 namespace tt::chat::server {
@@ -45,11 +80,15 @@ namespace tt::chat::server {
 
     class EpollServer {
     public:
-        explicit EpollServer(int port);
+        // One instance per shard; shard_id indexes group's mailboxes. Shard 0 of a
+        // single-shard group behaves exactly like the historical single-threaded server.
+        EpollServer(const ServerConfig& config, ShardGroup& group, int shard_id);
         ~EpollServer();
         void run();
+        // Async-signal-safe: makes run() return after the current loop iteration.
+        static void request_stop() { stop_requested_.store(true, std::memory_order_relaxed); }
+        const ServerStats& stats() const { return stats_; }
         int send_message(int client_sock, const std::string& message);
-        int send_message(int client_sock, const char* msg, size_t len, int flags);
 
     private:
         int listen_sock_;
@@ -59,49 +98,226 @@ namespace tt::chat::server {
         static constexpr int kBufferSize = 1024;
         static constexpr int kMaxEvents = 64;
         static constexpr int MAX_MESSAGE_SIZE = 1024 * 1024; // 1MB message size limit
+        static constexpr size_t kRecvBufferSize = 64 * 1024;
 
-        std::unordered_map<int, std::string> client_usernames_;
-        std::unordered_map<int, std::string> usernames_;
-        std::unordered_set<std::string> username_set_;
+        static inline std::atomic<bool> stop_requested_{false};
+
+        ServerConfig config_;
+        ServerStats stats_;
+        ShardGroup& group_;
+        int shard_id_;
+        AdaptiveSpin spin_;
+
+        // Every per-client field, indexed by fd (or fixed-file slot).
+        ConnectionTable connections_;
+        // Members on this shard only; channel existence and usernames live in the group's
+        // directory so they are unique across shards.
         std::unique_ptr<ChannelManager> channel_mgr_;
-        std::unordered_map<int, std::string> client_channels_;
+        std::uint64_t doorbells_ = 0;  // shards sent to since the last ring_doorbells()
+        // epoll: one large recv per readiness event lands here before being decoded.
+        std::unique_ptr<char[]> rx_buffer_;
+        std::uint64_t next_conn_id_ = 1;
+        std::uint64_t uploads_started_ = 0;  // numbers this shard's transfer ids
+        // Senders whose upload filled its window (fd, conn_id), resumed once it drains.
+        std::vector<std::pair<int, std::uint64_t>> window_paused_;
+        // Clients with frames queued and no send started yet, flushed in this order
+        // once due: at the end of the iteration, or coalesce_us after the first frame.
+        struct PendingFlush {
+            int fd;
+            std::uint64_t conn_id;
+            std::chrono::steady_clock::time_point due;
+        };
+        std::deque<PendingFlush> pending_flushes_;
+        // Negotiated compression: one stream each way per shard, and scratch space for
+        // the payload being compressed or inflated.
+        net::Compressor compressor_;
+        net::Decompressor decompressor_;
+        std::string compress_buf_;
+        std::string inflate_buf_;
+
+        // A channel message held back until the log batch holding it is on disk.
+        struct PendingBroadcast {
+            ChannelEntry* channel;
+            SharedFrame frame;  // v1
+            int sender_fd;
+            std::uint64_t sender_conn_id;
+        };
+        std::unique_ptr<MessageLog> message_log_;
+        std::deque<PendingBroadcast> pending_broadcasts_;  // in log order
+        size_t log_commit_records_ = 0;                    // records in the committing batch
+        bool log_commit_failed_ = false;
+        std::chrono::steady_clock::time_point log_commit_start_;
 
-        void setup_server_socket(int port);
-        void handle_new_connection();
-        void handle_client_data(int client_sock);
-        void parse_client_command(int client_sock, const std::string& msg);
+        void setup_server_socket(int port, bool reuse_port);
+        void parse_client_command(int client_sock, std::string_view msg);
+        // Protocol v2: the opcode maps straight to a command, nothing is parsed.
+        void dispatch_v2(int client_sock, net::Opcode opcode, std::string_view payload);
+        // One handler table for both protocols, indexed by Command.
+        void run_command(int client_sock, Command command, std::string_view arg);
+        // Feeds freshly read bytes through the client's decoder and dispatches every
+        // complete frame. Returns false if the stream is corrupt and the client must go.
+        bool decode_client_bytes(int client_sock, const char* data, size_t len);
+        void handle_client_disconnect(int client_fd);
+        Connection& open_connection(int client_fd);
+        ClientKey client_key(int client_fd) const { return make_client_key(shard_id_, client_fd); }
+        void move_to_channel(int client_sock, ChannelEntry* channel);
+        void leave_current_channel(int client_sock, Connection& conn);
 
         void disconnect_client(int client_sock);
         void cleanup_client(int client_sock); // New: unified cleanup function
 
         void broadcast_message(const std::string &message, int sender_fd);
-        void broadcast_to_channel(const std::string &channel, const std::string &msg, int sender_fd);
+        void broadcast_to_channel(ChannelEntry* channel, const FrameBuilder& body, int sender_fd);
+        SharedFrame encode_frame(const FrameBuilder& body, int protocol = net::kProtocolV1,
+                                 net::Opcode opcode = net::Opcode::kReply);
+        const SharedFrame& fanout_frame(FanoutFrames& frames, int protocol);
+        // The frame for one recipient: compressed for those that negotiated it, when the
+        // body is big enough and shrinks, else the plain one for its protocol.
+        const SharedFrame& fanout_frame(FanoutFrames& frames, const Connection& conn);
+        // A v2 frame flagged kFlagCompressed, or null if the body does not shrink.
+        SharedFrame compress_frame(const FrameBuilder& body, net::Opcode opcode);
+        void deliver_local(ChannelEntry* channel, FanoutFrames& frames, int sender_fd);
+        void forward_to_shards(ChannelEntry* channel, FanoutFrames& frames);
+        // Pushes to another shard's mailbox, draining our own while the peer is full.
+        void push_to_shard(int shard, const CrossShardMessage& msg);
+        // Queues a frame for a local client if it is still connection conn_id.
+        bool deliver_to_client(int fd, std::uint64_t conn_id, FanoutFrames& frames, int origin_fd);
+        // Same, for a client on any shard; a remote one checks its conn_id on arrival.
+        bool send_to_user(const UserLocation& where, FanoutFrames& frames, int origin_fd);
+        // Local delivery, cross-shard forwarding and history: everything a broadcast does
+        // once it may be seen.
+        void deliver_broadcast(ChannelEntry* channel, FanoutFrames& frames, int sender_fd);
+        // Starts writing the next log batch if none is in flight; called once per loop
+        // iteration. The epoll backend writes and syncs it before returning.
+        void commit_message_log();
+        void on_log_committed(bool ok);
+        // Shutdown: waits for the batch in flight and writes the rest synchronously.
+        void finish_message_log();
+        void drain_mailbox();
+        // Wakes every shard that was sent messages this iteration; called before blocking.
+        void ring_doorbells();
+        // Queues a frame for a client and starts writing it if nothing is in flight.
+        // origin_fd is the client whose input produced it, paused under the pause policy.
+        int send_frame(int client_sock, const SharedFrame& frame, int origin_fd);
+        // Puts a client on the flush list instead of sending right away (coalesce_sends).
+        void schedule_flush(int client_sock, Connection& conn);
+        // Flushes every client whose turn has come; called before the loop blocks.
+        void flush_due_clients();
+        // How long the loop may block before the next scheduled flush is due, or -1 to
+        // block until an event.
+        std::int64_t flush_wait_ns() const;
+        bool admit_over_cap(int client_sock, Connection& conn, size_t frame_size, int origin_fd);
+        void flush_outbound(int client_sock, Connection& conn);
+        void account_written(Connection& conn, size_t bytes, size_t requested);
+        void fail_outbound(int client_sock, Connection& conn);
+        void kick_client(int client_sock, Connection& conn);
+        void pause_reads(int client_sock);
+        void resume_reads(int client_sock);
+        void release_paused_senders(Connection& conn);
 
-        // Command handlers
-        void handle_name_command(int client_sock, const std::string& msg);
-        void handle_create_command(int client_sock, const std::string& msg);
-        void handle_join_command(int client_sock, const std::string& msg);
-        void handle_list_command(int client_sock);
-        void handle_users_command(int client_sock);
-        void handle_channel_message(int client_sock, const std::string& msg);
+        // Command handlers; all share one signature so they can sit in dispatch tables.
+        using CommandHandler = void (EpollServer::*)(int client_sock, std::string_view arg);
+        void handle_name_command(int client_sock, std::string_view arg);
+        void handle_create_command(int client_sock, std::string_view arg);
+        void handle_join_command(int client_sock, std::string_view arg);
+        void handle_list_command(int client_sock, std::string_view arg);
+        void handle_users_command(int client_sock, std::string_view arg);
+        void handle_channel_message(int client_sock, std::string_view arg);
+        void handle_proto_command(int client_sock, std::string_view arg);
+        void handle_bigmsg_command(int client_sock, std::string_view arg);
+        void handle_stats_command(int client_sock, std::string_view arg);
+        void handle_history_command(int client_sock, std::string_view arg);
+        void handle_dm_command(int client_sock, std::string_view arg);
+        void handle_sendfile_command(int client_sock, std::string_view arg);
+        void handle_sendchunk_command(int client_sock, std::string_view arg);
+        // Passes one frame of an upload (start, chunk or end) to its channel or user.
+        void relay_upload(const FileTransfer& upload, FanoutFrames& frames, int sender_fd);
+        // Tells the recipients the upload ended (complete or not) and forgets it.
+        void finish_upload(int client_sock, Connection& conn, bool complete);
+        // Resumes senders whose upload window has drained; called after the mailbox.
+        void resume_uploads();
+        // Sends up to `max_frames` of the channel's recent broadcasts as one batch.
+        void replay_history(int client_sock, const Connection& conn, size_t max_frames);
+        void handle_invalid_command(int client_sock, std::string_view arg);
 
         #ifdef IO_URING_ENABLED
+            // Provided-buffer ring shared by every multishot recv.
+            static constexpr unsigned kBufRingEntries = 512;   // must be a power of two
+            static constexpr unsigned kBufRingBufSize = 8192;
+            static constexpr int kBufGroupId = 0;
+
+            static constexpr unsigned kFixedFileSlots = 16384;
+
+            bool multishot_ = false;  // effective mode: config_.multishot and kernel support
+            // Effective mode: config_.fixed_files and kernel support. When set, clients are
+            // accepted straight into the ring's sparse file table and every "client_fd" in
+            // this class is a fixed-file slot index, not a process fd.
+            bool fixed_files_ = false;
+            // Effective mode: config_.zc_threshold > 0 and the kernel knows IORING_OP_SEND_ZC.
+            bool zero_copy_send_ = false;
+            io_uring_buf_ring* buf_ring_ = nullptr;
+            std::unique_ptr<char[]> buf_ring_slab_;
+
+            // Single-shot recv buffers, one per connection while multishot is unavailable.
+            struct RecvBuffer {
+                char data[kBufRingBufSize];
+            };
+            SlabPool<IoUringContext> ctx_pool_;
+            SlabPool<RecvBuffer, 16> recv_buffer_pool_;
+            SlabPool<SendBatch, 16> send_batch_pool_;
+
             void setup_io_uring();
+            bool setup_buf_ring();
+            bool probe_send_zc();
+            void init_ring();
+            // Low-latency mode: polls the CQ from user space before blocking.
+            bool spin_for_completions();
+            void wait_and_process_events();
             void handle_io_uring_events();
+            // SQEs are only queued by the submit_* helpers; the loop flushes them once per
+            // iteration. get_sqe() flushes early instead of failing when the SQ is full.
+            io_uring_sqe* get_sqe();
+            int flush_submissions();
             void submit_accept();
-            void submit_recv_length(int client_fd);     // New: submit length read
-            void submit_recv_message(int client_fd, int message_length); // New: submit message read
-            void submit_send(int client_fd, const std::string& message);
+            void submit_multishot_accept(IoUringContext* ctx);
+            void submit_multishot_recv(IoUringContext* ctx);
+            void start_client_recv(int client_fd);
+            void mark_client_sqe(io_uring_sqe* sqe) const;
+            void cancel_request(IoUringContext* ctx);
+            void close_client_file(int client_fd);
+            void recycle_buffer(unsigned buffer_id);
+            void on_client_accepted(int client_fd);
+            void handle_multishot_accept_completion(int result, unsigned flags, IoUringContext* ctx);
+            void handle_multishot_recv_completion(int result, unsigned flags, IoUringContext* ctx);
+            void submit_recv(IoUringContext* ctx);
+            bool submit_send(int client_fd, const SharedFrame& frame, size_t offset, std::uint64_t conn_id);
+            // One IORING_OP_SENDMSG for up to OutboundQueue::kMaxGather queued frames;
+            // returns how many it covers, 0 if no SQE could be had.
+            size_t submit_sendmsg(int client_fd, const Connection& conn);
+            void on_send_result(IoUringContext* ctx, int result);
+            void continue_recv(IoUringContext* ctx);
+            IoUringContext* new_context(IoOpType type, int fd);
+            IoUringContext* new_recv_context(int client_fd);
+            // Returns the context, and a single-shot recv's buffer, to their pools.
+            void release_context(IoUringContext* ctx);
+            void submit_wakeup_read(IoUringContext* ctx);
             void handle_accept_completion(int result, IoUringContext* ctx);
-            void handle_recv_length_completion(int result, IoUringContext* ctx);   // New
-            void handle_recv_message_completion(int result, IoUringContext* ctx);  // New
+            void handle_recv_completion(int result, IoUringContext* ctx);
             void handle_send_completion(int result, IoUringContext* ctx);
-            void handle_client_disconnect(int client_fd);
-            int send_message_uring(int client_sock, const std::string& message);
+            void handle_send_zc_completion(int result, unsigned flags, IoUringContext* ctx);
+            void handle_log_completion(int result, IoUringContext* ctx);
             
         #else 
+            // Edge-triggered reads of one client per readiness event before it yields to
+            // the others; the rest of its data is picked up from read_backlog_.
+            static constexpr int kMaxReadsPerEvent = 16;
+            std::vector<int> read_backlog_;
+
             void setup_epoll();
+            void handle_new_connection();
+            void handle_client_data(int client_sock);
             void handle_epoll_events(struct epoll_event events[]);
+            void update_epoll_events(int client_sock, Connection& conn);
         #endif
     };
 
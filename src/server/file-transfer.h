@@ -0,0 +1,82 @@
+#ifndef FILE_TRANSFER_H
+#define FILE_TRANSFER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "shard-group.h"
+#include "shared-frame.h"
+#include "username-index.h"
+
+namespace tt::chat::server {
+
+    /**
+     * One /sendfile upload being relayed. The file is never assembled: each chunk is
+     * framed once per protocol and shared by every recipient, like a broadcast, and freed
+     * as soon as the last recipient has written it. What bounds the memory is the window.
+     * Every frame built for a chunk, on any shard, counts in in_flight until its last
+     * reference goes, and the sender's reads pause while in_flight is over the window.
+     *
+     * Owned by the sending connection and only touched by its shard, except in_flight
+     * and paused, which the shards holding its frames update when they release them,
+     * and incompressible.
+     */
+    struct FileTransfer {
+        FileTransfer(std::uint64_t id, std::string name, std::uint64_t size, size_t window,
+                     ShardMailbox& sender_mailbox)
+            : id(id), name(std::move(name)), size(size), window(window), sender_mailbox(sender_mailbox),
+              chunk_prefix("[CHUNK " + std::to_string(id) + "] ") {}
+
+        // Wraps a frame built for this transfer so its bytes count against the window
+        // until the last reference to it goes; that release wakes the sending shard if
+        // it is waiting for the window to drain.
+        static SharedFrame track(const std::shared_ptr<FileTransfer>& transfer, SharedFrame frame) {
+            size_t bytes = frame->size();
+            transfer->in_flight.fetch_add(bytes);
+            const std::string* data = frame.get();
+            return SharedFrame(data, [frame = std::move(frame), transfer, bytes](const std::string*) {
+                size_t left = transfer->in_flight.fetch_sub(bytes) - bytes;
+                if (left <= transfer->window / 2 && transfer->paused.load()) {
+                    transfer->sender_mailbox.notify();
+                }
+            });
+        }
+
+        // Sender's shard, after relaying a chunk: true if reads must now pause. paused is
+        // set before in_flight is read again, so a release on another shard either sees
+        // the flag and wakes us, or its decrement is seen here.
+        bool should_pause() {
+            if (paused.load() || in_flight.load() <= window) return false;
+            paused.store(true);
+            if (in_flight.load() > window / 2) return true;
+            paused.store(false);
+            return false;
+        }
+
+        // Resume once half the window is free again, so a sender is not woken per frame.
+        bool drained() const { return in_flight.load() <= window / 2; }
+
+        const std::uint64_t id;
+        const std::string name;
+        const std::uint64_t size;
+        std::uint64_t received = 0;
+        // Where it goes: a channel, or one user when channel is null.
+        ChannelEntry* channel = nullptr;
+        UserLocation user;
+
+        const size_t window;
+        ShardMailbox& sender_mailbox;
+        const std::string chunk_prefix;  // "[CHUNK <id>] ", the head of every relayed chunk
+        std::atomic<size_t> in_flight{0};
+        std::atomic<bool> paused{false};
+        // Set by any shard once a chunk did not shrink: the rest of an already compressed
+        // file goes out plain without paying for more attempts.
+        std::atomic<bool> incompressible{false};
+    };
+
+} // namespace tt::chat::server
+
+#endif // FILE_TRANSFER_H
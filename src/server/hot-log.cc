@@ -0,0 +1,64 @@
+#include "hot-log.h"
+
+#include <chrono>
+#include <string_view>
+
+namespace tt::chat::server {
+
+void HotLog::start(LogMode mode, int sample_every, int payload_max, int producers) {
+  mode_ = mode;
+  sample_every_ = sample_every > 0 ? static_cast<std::uint32_t>(sample_every) : 1;
+  payload_max_ = payload_max > 0 ? static_cast<size_t>(payload_max) : 0;
+  if (mode_ != LogMode::kAsync && mode_ != LogMode::kSampled) {
+    return;
+  }
+  for (int i = 0; i < producers; ++i) {
+    rings_.push_back(std::make_unique<Ring>());
+  }
+  writer_ = std::thread(writer_loop);
+}
+
+void HotLog::attach(int producer) {
+  if (producer >= 0 && producer < static_cast<int>(rings_.size())) {
+    ring_ = rings_[producer].get();
+  }
+}
+
+size_t HotLog::drain() {
+  size_t count = 0;
+  spdlog::logger* logger = spdlog::default_logger_raw();
+  for (auto& ring : rings_) {
+    while (auto record = ring->queue.try_pop()) {
+      logger->log(record->time, spdlog::source_loc{}, record->level, std::string_view(record->text, record->size));
+      ++count;
+    }
+  }
+  written_ += count;
+  return count;
+}
+
+void HotLog::writer_loop() {
+  // The rings are sized for bursts, so an idle writer can afford to nap instead of
+  // being woken by every producer.
+  while (!stopping_.load(std::memory_order_acquire)) {
+    if (drain() == 0) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+  drain();
+}
+
+void HotLog::stop() {
+  if (!writer_.joinable()) {
+    return;
+  }
+  stopping_.store(true, std::memory_order_release);
+  writer_.join();
+  std::uint64_t dropped = 0;
+  for (auto& ring : rings_) {
+    dropped += ring->dropped.load(std::memory_order_relaxed);
+  }
+  SPDLOG_INFO("Log stats: mode={} written={} dropped={}", to_string(mode_), written_, dropped);
+}
+
+} // namespace tt::chat::server
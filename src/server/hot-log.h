@@ -0,0 +1,123 @@
+#ifndef HOT_LOG_H
+#define HOT_LOG_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <fmt/format.h>
+#include <spdlog/spdlog.h>
+
+#include "server-config.h"
+#include "spsc-queue.h"
+
+namespace tt::chat::server {
+
+    /**
+     * Moves per-message logging off the event loops. Each shard formats a record into a
+     * fixed-size slot of its own SPSC ring; one writer thread drains every ring into
+     * spdlog's sinks. A full ring drops the record (and counts it) rather than making
+     * the event loop wait on the writer. Records carry the time they were made, so a
+     * writer that falls behind does not shift or bunch up the logged times.
+     */
+    class HotLog {
+    public:
+        static constexpr size_t kRecordText = 240;
+        static constexpr size_t kRingCapacity = 8192;
+
+        struct Record {
+            spdlog::log_clock::time_point time;
+            spdlog::level::level_enum level = spdlog::level::info;
+            std::uint16_t size = 0;
+            char text[kRecordText];
+        };
+
+        // Called once before the shards start; `producers` is the number of shards.
+        static void start(LogMode mode, int sample_every, int payload_max, int producers);
+        // Drains and joins the writer, then logs a "Log stats:" summary.
+        static void stop();
+        // Binds the calling thread to its ring. Threads that never attach log synchronously.
+        static void attach(int producer);
+
+        static LogMode mode() { return mode_; }
+
+        // Per-site gate. `site_calls` is a thread_local counter owned by the call site.
+        static bool enabled(spdlog::level::level_enum level, std::uint32_t& site_calls) {
+            switch (mode_) {
+                case LogMode::kOff: return false;
+                case LogMode::kSampled:
+                    if (site_calls++ % sample_every_ != 0) return false;
+                    break;
+                default: break;
+            }
+            return spdlog::default_logger_raw()->should_log(level);
+        }
+
+        // Shortens a client payload to the configured --log-payload-max (0 = no limit).
+        static std::string_view payload(std::string_view body) {
+            return payload_max_ > 0 ? body.substr(0, payload_max_) : body;
+        }
+
+        template <typename... Args>
+        static void write(spdlog::level::level_enum level, fmt::format_string<Args...> fmt, Args&&... args) {
+            if (!ring_) {
+                spdlog::default_logger_raw()->log(level, fmt, std::forward<Args>(args)...);
+                return;
+            }
+            Record record;
+            record.time = spdlog::log_clock::now();
+            record.level = level;
+            auto result = fmt::format_to_n(record.text, kRecordText, fmt, std::forward<Args>(args)...);
+            record.size = static_cast<std::uint16_t>(result.size < kRecordText ? result.size : kRecordText);
+            if (!ring_->queue.try_push(record)) {
+                ring_->dropped.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+
+    private:
+        struct Ring {
+            SpscQueue<Record> queue{kRingCapacity};
+            std::atomic<std::uint64_t> dropped{0};
+        };
+
+        static void writer_loop();
+        static size_t drain();
+
+        static inline LogMode mode_ = LogMode::kSync;
+        static inline std::uint32_t sample_every_ = 1;
+        static inline size_t payload_max_ = 0;
+        static inline std::vector<std::unique_ptr<Ring>> rings_;
+        static inline std::thread writer_;
+        static inline std::atomic<bool> stopping_{false};
+        static inline std::uint64_t written_ = 0;  // writer thread only
+        static inline thread_local Ring* ring_ = nullptr;
+    };
+
+} // namespace tt::chat::server
+
+// Per-message logging. Compiled out entirely when the build's SPDLOG_ACTIVE_LEVEL is above
+// the level (e.g. `make LOG_LEVEL=WARN`), otherwise gated at run time by --log-mode.
+#define HOT_LOG(level, ...)                                                             \
+    do {                                                                                \
+        static thread_local std::uint32_t hot_log_site_calls = 0;                       \
+        if (::tt::chat::server::HotLog::enabled(level, hot_log_site_calls)) {           \
+            ::tt::chat::server::HotLog::write(level, __VA_ARGS__);                      \
+        }                                                                               \
+    } while (0)
+
+#if SPDLOG_ACTIVE_LEVEL <= SPDLOG_LEVEL_DEBUG
+#define HOT_LOG_DEBUG(...) HOT_LOG(spdlog::level::debug, __VA_ARGS__)
+#else
+#define HOT_LOG_DEBUG(...) (void)0
+#endif
+
+#if SPDLOG_ACTIVE_LEVEL <= SPDLOG_LEVEL_INFO
+#define HOT_LOG_INFO(...) HOT_LOG(spdlog::level::info, __VA_ARGS__)
+#else
+#define HOT_LOG_INFO(...) (void)0
+#endif
+
+#endif // HOT_LOG_H
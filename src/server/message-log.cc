@@ -0,0 +1,151 @@
+#include "message-log.h"
+#include "../utils.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+
+namespace tt::chat::server {
+
+namespace {
+
+// shard-<shard>-<seq>.log; returns false for any other file name.
+bool parse_segment_name(const std::string& name, int shard, std::uint64_t& seq) {
+  std::string prefix = "shard-" + std::to_string(shard) + "-";
+  if (name.rfind(prefix, 0) != 0 || name.size() <= prefix.size() + 4 ||
+      name.compare(name.size() - 4, 4, ".log") != 0) {
+    return false;
+  }
+  std::string digits = name.substr(prefix.size(), name.size() - prefix.size() - 4);
+  if (digits.find_first_not_of("0123456789") != std::string::npos) {
+    return false;
+  }
+  seq = std::stoull(digits);
+  return true;
+}
+
+template <typename T>
+void append_raw(std::string& out, T value) {
+  out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+} // namespace
+
+MessageLog::MessageLog(const std::string& dir, int shard, Durability durability, size_t segment_bytes)
+    : dir_(dir), shard_(shard), durability_(durability), segment_bytes_(segment_bytes) {
+  std::error_code ec;
+  std::filesystem::create_directories(dir_, ec);
+  check_error(static_cast<bool>(ec), "cannot create message log directory " + dir_ + ": " + ec.message());
+  for (const auto& entry : std::filesystem::directory_iterator(dir_)) {
+    std::uint64_t seq;
+    if (parse_segment_name(entry.path().filename().string(), shard_, seq) && seq > segment_seq_) {
+      segment_seq_ = seq;
+    }
+  }
+  open_segment();
+}
+
+MessageLog::~MessageLog() {
+  if (fd_ >= 0) {
+    close(fd_);
+  }
+}
+
+void MessageLog::open_segment() {
+  if (fd_ >= 0) {
+    close(fd_);
+  }
+  ++segment_seq_;
+  char name[64];
+  snprintf(name, sizeof(name), "shard-%d-%08llu.log", shard_, static_cast<unsigned long long>(segment_seq_));
+  std::string path = dir_ + "/" + name;
+  fd_ = open(path.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+  check_error(fd_ < 0, "cannot create message log segment " + path + ": " + strerror(errno));
+  segment_size_ = 0;
+  if (durability_ != Durability::kNone) {
+    // The new directory entry must survive a crash too, or so would nothing in it.
+    int dir_fd = open(dir_.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dir_fd >= 0) {
+      fsync(dir_fd);
+      close(dir_fd);
+    }
+  }
+}
+
+std::uint32_t MessageLog::checksum(std::string_view payload) {
+  std::uint32_t hash = 2166136261u;
+  for (unsigned char c : payload) {
+    hash = (hash ^ c) * 16777619u;
+  }
+  return hash;
+}
+
+void MessageLog::append(std::string_view channel, std::string_view body) {
+  size_t payload_size = sizeof(std::uint16_t) + channel.size() + body.size();
+  size_t start = open_data_.size();
+  open_data_.reserve(start + kRecordHeaderSize + payload_size);
+  append_raw(open_data_, static_cast<std::uint32_t>(payload_size));
+  append_raw(open_data_, std::uint32_t{0});  // checksum, filled in below
+  auto now = std::chrono::system_clock::now().time_since_epoch();
+  append_raw(open_data_, static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(now).count()));
+  // /create caps names at kMaxChannelNameLength, so this cannot wrap.
+  append_raw(open_data_, static_cast<std::uint16_t>(channel.size()));
+  open_data_.append(channel);
+  open_data_.append(body);
+  std::uint32_t sum = checksum(std::string_view(open_data_).substr(start + kRecordHeaderSize));
+  std::memcpy(open_data_.data() + start + sizeof(std::uint32_t), &sum, sizeof(sum));
+  ++open_records_;
+}
+
+size_t MessageLog::begin_commit() {
+  size_t records = open_records_;
+  size_t bytes = open_data_.size() - open_consumed_;
+  if (durability_ == Durability::kPerMessage) {
+    std::uint32_t payload_size;
+    std::memcpy(&payload_size, open_data_.data() + open_consumed_, sizeof(payload_size));
+    records = 1;
+    bytes = kRecordHeaderSize + payload_size;
+  }
+  if (segment_size_ > 0 && static_cast<size_t>(segment_size_) + bytes > segment_bytes_) {
+    open_segment();
+  }
+  committing_data_.assign(open_data_, open_consumed_, bytes);
+  open_records_ -= records;
+  open_consumed_ += bytes;
+  // Per-message commits take records off the front one at a time. Erasing each would
+  // move the whole backlog every time, so the buffer is only compacted once drained,
+  // or once the consumed prefix outgrows what is left.
+  if (open_records_ == 0) {
+    open_data_.clear();
+    open_consumed_ = 0;
+  } else if (open_consumed_ > open_data_.size() / 2) {
+    open_data_.erase(0, open_consumed_);
+    open_consumed_ = 0;
+  }
+  commit_offset_ = segment_size_;
+  segment_size_ += bytes;
+  committing_ = true;
+  return records;
+}
+
+bool MessageLog::write_sync() {
+  size_t done = 0;
+  while (done < committing_data_.size()) {
+    ssize_t n = pwrite(fd_, committing_data_.data() + done, committing_data_.size() - done,
+                       commit_offset_ + done);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return false;
+    done += n;
+  }
+  return !commit_needs_sync() || fdatasync(fd_) == 0;
+}
+
+void MessageLog::end_commit() {
+  committing_data_.clear();
+  committing_ = false;
+}
+
+} // namespace tt::chat::server
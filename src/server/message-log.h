@@ -0,0 +1,84 @@
+#ifndef MESSAGE_LOG_H
+#define MESSAGE_LOG_H
+
+#include <sys/types.h>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "server-config.h"
+
+namespace tt::chat::server {
+
+    /**
+     * One shard's append-only log of channel messages, split into segment files named
+     * shard-<shard>-<seq>.log. Each record is
+     *
+     *   u32 payload length | u32 FNV-1a of the payload | u64 unix time in ns
+     *   payload: u16 channel name length | channel name | message body
+     *
+     * in host byte order. A restart always opens a new segment, so a record torn by a
+     * crash can only be at the end of a segment, where its length or checksum gives it
+     * away.
+     *
+     * Records are appended to an open batch. The owner takes the batch with
+     * begin_commit(), writes it (IORING_OP_WRITE, or write_sync()) at
+     * commit_offset() in commit_fd(), fsyncs it if commit_needs_sync(), then calls
+     * end_commit(). At most one batch is committing at a time, so a batch holds
+     * whatever arrived while the previous one was on its way to disk: that is the group
+     * commit. Under per-message durability a batch is a single record.
+     */
+    class MessageLog {
+    public:
+        static constexpr size_t kRecordHeaderSize = 16;
+
+        MessageLog(const std::string& dir, int shard, Durability durability, size_t segment_bytes);
+        ~MessageLog();
+
+        MessageLog(const MessageLog&) = delete;
+        MessageLog& operator=(const MessageLog&) = delete;
+
+        void append(std::string_view channel, std::string_view body);
+
+        Durability durability() const { return durability_; }
+        bool committing() const { return committing_; }
+        // True when a batch is waiting and none is committing.
+        bool ready_to_commit() const { return !committing_ && open_records_ > 0; }
+
+        // Moves the open batch (or, per-message, its first record) to the committing
+        // slot, rolling to a new segment first if the batch would overflow this one.
+        // Returns the number of records in it.
+        size_t begin_commit();
+        const std::string& commit_data() const { return committing_data_; }
+        int commit_fd() const { return fd_; }
+        off_t commit_offset() const { return commit_offset_; }
+        bool commit_needs_sync() const { return durability_ != Durability::kNone; }
+        // Writes and syncs the committing batch with blocking calls. Returns false on error.
+        bool write_sync();
+        void end_commit();
+
+        static std::uint32_t checksum(std::string_view payload);
+
+    private:
+        void open_segment();
+
+        std::string dir_;
+        int shard_;
+        Durability durability_;
+        size_t segment_bytes_;
+        int fd_ = -1;
+        std::uint64_t segment_seq_ = 0;
+        off_t segment_size_ = 0;  // bytes handed out to commits in this segment
+
+        std::string open_data_;
+        size_t open_consumed_ = 0;  // bytes at the front of open_data_ already committed
+        size_t open_records_ = 0;
+        std::string committing_data_;
+        off_t commit_offset_ = 0;
+        bool committing_ = false;
+    };
+
+} // namespace tt::chat::server
+
+#endif // MESSAGE_LOG_H
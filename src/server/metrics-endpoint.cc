@@ -0,0 +1,74 @@
+#include "metrics-endpoint.h"
+#include "../utils.h"
+
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <utility>
+
+namespace tt::chat::server {
+
+namespace {
+
+// A scraper gets about this long for the whole dump. One that stops reading must not keep the
+// thread, or the destructor's join(), waiting on it.
+constexpr auto kSendDeadline = std::chrono::seconds(1);
+
+} // namespace
+
+MetricsEndpoint::MetricsEndpoint(std::string path, std::function<std::string()> render)
+    : path_(std::move(path)), render_(std::move(render)) {
+  sockaddr_un addr{};
+  check_error(path_.size() >= sizeof(addr.sun_path), "--metrics-socket path is too long");
+  addr.sun_family = AF_UNIX;
+  std::memcpy(addr.sun_path, path_.c_str(), path_.size() + 1);
+
+  listen_fd_ = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  check_error(listen_fd_ < 0, "metrics socket creation failed");
+  unlink(path_.c_str());
+  if (bind(listen_fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 ||
+      listen(listen_fd_, 4) < 0) {
+    close(listen_fd_);
+    check_error(true, "metrics socket bind failed for " + path_ + ": " + strerror(errno));
+  }
+  thread_ = std::thread([this] { serve(); });
+  SPDLOG_INFO("Serving metrics on unix:{}", path_);
+}
+
+MetricsEndpoint::~MetricsEndpoint() {
+  stopping_.store(true, std::memory_order_relaxed);
+  // Wakes the blocking accept().
+  shutdown(listen_fd_, SHUT_RDWR);
+  thread_.join();
+  close(listen_fd_);
+  unlink(path_.c_str());
+}
+
+void MetricsEndpoint::serve() {
+  while (!stopping_.load(std::memory_order_relaxed)) {
+    int fd = accept4(listen_fd_, nullptr, nullptr, SOCK_CLOEXEC);
+    if (fd < 0) {
+      if (errno == EINTR || errno == ECONNABORTED) continue;
+      break;
+    }
+    timeval timeout{std::chrono::duration_cast<std::chrono::seconds>(kSendDeadline).count(), 0};
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    auto deadline = std::chrono::steady_clock::now() + kSendDeadline;
+    std::string body = render_();
+    size_t sent = 0;
+    while (sent < body.size() && std::chrono::steady_clock::now() < deadline) {
+      // Each send() blocks for at most SO_SNDTIMEO, then fails with EAGAIN.
+      ssize_t n = send(fd, body.data() + sent, body.size() - sent, MSG_NOSIGNAL);
+      if (n < 0 && errno == EINTR) continue;
+      if (n <= 0) break;
+      sent += n;
+    }
+    close(fd);
+  }
+}
+
+} // namespace tt::chat::server
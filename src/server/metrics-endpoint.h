@@ -0,0 +1,39 @@
+#ifndef METRICS_ENDPOINT_H
+#define METRICS_ENDPOINT_H
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include <thread>
+
+namespace tt::chat::server {
+
+    /**
+     * Local metrics scrape point: a Unix stream socket whose every connection receives
+     * one render() and is closed, e.g. `socat - UNIX-CONNECT:<path>`. Served from its own
+     * thread, so a scrape never runs on an event loop; render() must only read
+     * thread-safe state (ServerStats counters are).
+     */
+    class MetricsEndpoint {
+    public:
+        // Binds and starts serving; a stale socket file at `path` is replaced.
+        // @throws std::runtime_error if the socket cannot be bound.
+        MetricsEndpoint(std::string path, std::function<std::string()> render);
+        ~MetricsEndpoint();
+
+        MetricsEndpoint(const MetricsEndpoint&) = delete;
+        MetricsEndpoint& operator=(const MetricsEndpoint&) = delete;
+
+    private:
+        void serve();
+
+        std::string path_;
+        std::function<std::string()> render_;
+        int listen_fd_ = -1;
+        std::atomic<bool> stopping_{false};
+        std::thread thread_;
+    };
+
+} // namespace tt::chat::server
+
+#endif // METRICS_ENDPOINT_H
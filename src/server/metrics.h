@@ -0,0 +1,86 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+
+#include <fmt/format.h>
+
+namespace tt::chat::server {
+
+    /**
+     * A counter with exactly one writer, the owning event loop, that any thread may read.
+     * Updates are a relaxed load and store rather than a locked read-modify-write, so on
+     * x86 they compile to the same plain add as a uint64_t; readers see each value whole
+     * but may be a few updates behind.
+     */
+    class Counter {
+    public:
+        Counter() = default;
+        Counter(const Counter&) = delete;
+        Counter& operator=(const Counter&) = delete;
+
+        std::uint64_t load() const { return value_.load(std::memory_order_relaxed); }
+        operator std::uint64_t() const { return load(); }
+
+        Counter& operator=(std::uint64_t value) {
+            value_.store(value, std::memory_order_relaxed);
+            return *this;
+        }
+        Counter& operator+=(std::uint64_t n) { return *this = load() + n; }
+        Counter& operator-=(std::uint64_t n) { return *this = load() - n; }
+        Counter& operator++() { return *this += 1; }
+        std::uint64_t operator++(int) {
+            std::uint64_t old = load();
+            *this = old + 1;
+            return old;
+        }
+
+    private:
+        std::atomic<std::uint64_t> value_{0};
+    };
+
+    /**
+     * Single-writer histogram with power-of-two buckets: bucket 0 counts zeros and bucket
+     * i counts values in [2^(i-1), 2^i). Recording is a bit scan and two counter updates.
+     */
+    class Histogram {
+    public:
+        static constexpr size_t kBuckets = 40;
+
+        void record(std::uint64_t value) {
+            size_t bucket = std::min<size_t>(std::bit_width(value), kBuckets - 1);
+            ++buckets_[bucket];
+            sum_ += value;
+        }
+
+        // Largest value bucket i holds; the last bucket is unbounded.
+        static std::uint64_t upper_bound(size_t bucket) { return (std::uint64_t{1} << bucket) - 1; }
+
+        std::uint64_t bucket(size_t i) const { return buckets_[i]; }
+        std::uint64_t sum() const { return sum_; }
+        std::uint64_t count() const {
+            std::uint64_t total = 0;
+            for (const Counter& b : buckets_) total += b;
+            return total;
+        }
+
+    private:
+        Counter buckets_[kBuckets];
+        Counter sum_;
+    };
+
+} // namespace tt::chat::server
+
+template <>
+struct fmt::formatter<tt::chat::server::Counter> : fmt::formatter<std::uint64_t> {
+    template <typename FormatContext>
+    auto format(const tt::chat::server::Counter& counter, FormatContext& ctx) const {
+        return fmt::formatter<std::uint64_t>::format(counter.load(), ctx);
+    }
+};
+
+#endif // METRICS_H
@@ -0,0 +1,114 @@
+#ifndef OUTBOUND_QUEUE_H
+#define OUTBOUND_QUEUE_H
+
+#include <sys/uio.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <deque>
+
+#include "shared-frame.h"
+
+namespace tt::chat::server {
+
+    /**
+     * Frames waiting to be written to one connection, in order. The front frame may be
+     * partially written; front_offset() says how much of it already went out, so a short
+     * send resumes where it stopped instead of corrupting the stream. At most one send
+     * per connection is outstanding (in_flight()), which keeps the bytes ordered; it may
+     * cover several frames from the front, gathered into one vectored write.
+     */
+    class OutboundQueue {
+    public:
+        // Most frames one vectored send gathers.
+        static constexpr size_t kMaxGather = 64;
+
+        bool empty() const { return frames_.empty(); }
+        size_t frames() const { return frames_.size(); }
+        // Unsent bytes, including the unsent tail of a partially written front frame.
+        size_t bytes() const { return bytes_; }
+
+        bool in_flight() const { return in_flight_frames_ > 0; }
+        // Frames from the front covered by the outstanding send, 0 once it completed.
+        void set_in_flight(size_t frames) { in_flight_frames_ = frames; }
+
+        void push(SharedFrame frame) {
+            bytes_ += frame->size();
+            frames_.push_back(std::move(frame));
+        }
+
+        const SharedFrame& front() const { return frames_.front(); }
+        const SharedFrame& at(size_t i) const { return frames_[i]; }
+        size_t front_offset() const { return offset_; }
+        const char* pending_data() const { return frames_.front()->data() + offset_; }
+        size_t pending_size() const { return frames_.front()->size() - offset_; }
+
+        /**
+         * Points iov at the unsent bytes of up to max_frames frames from the front, the
+         * first one from its offset. Returns the number of entries filled; their total
+         * length is added to `bytes`.
+         */
+        size_t gather(iovec* iov, size_t max_frames, size_t& bytes) const {
+            size_t count = std::min(max_frames, frames_.size());
+            for (size_t i = 0; i < count; ++i) {
+                size_t skip = i == 0 ? offset_ : 0;
+                iov[i].iov_base = const_cast<char*>(frames_[i]->data()) + skip;
+                iov[i].iov_len = frames_[i]->size() - skip;
+                bytes += iov[i].iov_len;
+            }
+            return count;
+        }
+
+        // Records that n bytes from the front were written, possibly across several
+        // frames. Returns the number of frames that finished (they are popped).
+        size_t consume(size_t n) {
+            bytes_ -= n;
+            size_t finished = 0;
+            while (n > 0) {
+                size_t left = frames_.front()->size() - offset_;
+                if (n < left) {
+                    offset_ += n;
+                    break;
+                }
+                n -= left;
+                frames_.pop_front();
+                offset_ = 0;
+                ++finished;
+            }
+            return finished;
+        }
+
+        /**
+         * Drops whole frames from the front until `incoming` more bytes fit under `cap`.
+         * A frame that is partially written or has a send in flight is never dropped:
+         * the peer would see a torn frame. Returns the number of frames dropped.
+         */
+        size_t drop_oldest(size_t incoming, size_t cap) {
+            size_t keep_front = std::max(in_flight_frames_, size_t{offset_ > 0 ? 1u : 0u});
+            size_t dropped = 0;
+            while (frames_.size() > keep_front && bytes_ + incoming > cap) {
+                auto victim = frames_.begin() + keep_front;
+                bytes_ -= (*victim)->size();
+                frames_.erase(victim);
+                ++dropped;
+            }
+            return dropped;
+        }
+
+        // Forgets everything still queued; an in-flight send keeps its own frame reference.
+        void clear() {
+            frames_.clear();
+            bytes_ = 0;
+            offset_ = 0;
+        }
+
+    private:
+        std::deque<SharedFrame> frames_;
+        size_t bytes_ = 0;
+        size_t offset_ = 0;
+        size_t in_flight_frames_ = 0;
+    };
+
+} // namespace tt::chat::server
+
+#endif // OUTBOUND_QUEUE_H
@@ -0,0 +1,286 @@
+#include "server-config.h"
+#include "../utils.h"
+
+#include <functional>
+#include <iostream>
+#include <string_view>
+#include <vector>
+
+namespace tt::chat::server {
+
+namespace {
+
+struct Option {
+  const char* name;
+  bool is_flag;  // flags take no value and may be negated with --no-<name>
+  std::function<void(ServerConfig&, const std::string&)> apply;
+  const char* help;
+};
+
+int parse_int(const std::string& name, const std::string& value) {
+  try {
+    size_t used = 0;
+    int parsed = std::stoi(value, &used);
+    check_error(used != value.size(), "Invalid value for --" + name + ": " + value);
+    return parsed;
+  } catch (const std::logic_error&) {
+    check_error(true, "Invalid value for --" + name + ": " + value);
+  }
+  return 0;
+}
+
+bool parse_bool(const std::string& name, const std::string& value) {
+  if (value == "1" || value == "true" || value == "on") return true;
+  if (value == "0" || value == "false" || value == "off") return false;
+  check_error(true, "Invalid value for --" + name + ": " + value);
+  return false;
+}
+
+SlowConsumerPolicy parse_policy(const std::string& value) {
+  for (auto policy : {SlowConsumerPolicy::kDropOldest, SlowConsumerPolicy::kDisconnect,
+                      SlowConsumerPolicy::kPause}) {
+    if (value == to_string(policy)) return policy;
+  }
+  check_error(true, "Invalid value for --slow-consumer: " + value);
+  return SlowConsumerPolicy::kDropOldest;
+}
+
+LogMode parse_log_mode(const std::string& value) {
+  for (auto mode : {LogMode::kSync, LogMode::kAsync, LogMode::kSampled, LogMode::kOff}) {
+    if (value == to_string(mode)) return mode;
+  }
+  check_error(true, "Invalid value for --log-mode: " + value);
+  return LogMode::kSync;
+}
+
+Durability parse_durability(const std::string& value) {
+  for (auto durability : {Durability::kNone, Durability::kBatch, Durability::kPerMessage}) {
+    if (value == to_string(durability)) return durability;
+  }
+  check_error(true, "Invalid value for --durability: " + value);
+  return Durability::kBatch;
+}
+
+const std::vector<Option>& options() {
+  static const std::vector<Option> kOptions = {
+    {"port", false,
+     [](ServerConfig& c, const std::string& v) { c.port = parse_int("port", v); },
+     "TCP port to listen on (default 8080)"},
+    {"shards", false,
+     [](ServerConfig& c, const std::string& v) {
+       c.shards = parse_int("shards", v);
+       check_error(c.shards < 1 || c.shards > 64, "--shards must be between 1 and 64");
+     },
+     "Event-loop threads sharing the port via SO_REUSEPORT (default 1)"},
+    {"multishot", true,
+     [](ServerConfig& c, const std::string& v) { c.multishot = parse_bool("multishot", v); },
+     "io_uring: multishot accept/recv with a provided-buffer ring (default on)"},
+    {"fixed-files", true,
+     [](ServerConfig& c, const std::string& v) { c.fixed_files = parse_bool("fixed-files", v); },
+     "io_uring: registered file table with direct accept (default off)"},
+    {"zc-threshold", false,
+     [](ServerConfig& c, const std::string& v) {
+       c.zc_threshold = parse_int("zc-threshold", v);
+       check_error(c.zc_threshold < 0, "--zc-threshold must be >= 0");
+     },
+     "io_uring: zero-copy send for frames >= N bytes, 0 = off (default 32768)"},
+    {"sqpoll", true,
+     [](ServerConfig& c, const std::string& v) { c.sqpoll = parse_bool("sqpoll", v); },
+     "io_uring: kernel SQ polling thread per shard (default off)"},
+    {"sqpoll-idle-ms", false,
+     [](ServerConfig& c, const std::string& v) { c.sqpoll_idle_ms = parse_int("sqpoll-idle-ms", v); },
+     "io_uring: SQ thread idle time before it sleeps (default 100)"},
+    {"sqpoll-cpu", false,
+     [](ServerConfig& c, const std::string& v) { c.sqpoll_cpu = parse_int("sqpoll-cpu", v); },
+     "io_uring: pin shard i's SQ thread to CPU N+i, -1 = unpinned (default -1)"},
+    {"busy-poll-us", false,
+     [](ServerConfig& c, const std::string& v) {
+       c.busy_poll_us = parse_int("busy-poll-us", v);
+       check_error(c.busy_poll_us < 0, "--busy-poll-us must be >= 0");
+     },
+     "SO_BUSY_POLL on client sockets, 0 = off (default 0)"},
+    {"spin-us", false,
+     [](ServerConfig& c, const std::string& v) {
+       c.spin_us = parse_int("spin-us", v);
+       check_error(c.spin_us < 0, "--spin-us must be >= 0");
+     },
+     "Adaptive spin before blocking for events, 0 = off (default 0)"},
+    {"coalesce-sends", true,
+     [](ServerConfig& c, const std::string& v) { c.coalesce_sends = parse_bool("coalesce-sends", v); },
+     "Send each client's frames once per loop iteration, vectored (default on)"},
+    {"coalesce-us", false,
+     [](ServerConfig& c, const std::string& v) {
+       c.coalesce_us = parse_int("coalesce-us", v);
+       check_error(c.coalesce_us < 0, "--coalesce-us must be >= 0");
+     },
+     "Extra microseconds a client's output may wait to batch more frames (default 0)"},
+    {"max-queued-bytes", false,
+     [](ServerConfig& c, const std::string& v) {
+       c.max_queued_bytes = parse_int("max-queued-bytes", v);
+       check_error(c.max_queued_bytes <= 0, "--max-queued-bytes must be > 0");
+     },
+     "Per-client cap on bytes waiting to be sent (default 4194304)"},
+    {"slow-consumer", false,
+     [](ServerConfig& c, const std::string& v) { c.slow_consumer = parse_policy(v); },
+     "At the cap: drop-oldest | disconnect | pause (default drop-oldest)"},
+    {"file-window-bytes", false,
+     [](ServerConfig& c, const std::string& v) {
+       c.file_window_bytes = parse_int("file-window-bytes", v);
+       check_error(c.file_window_bytes <= 0, "--file-window-bytes must be > 0");
+     },
+     "Unwritten bytes per /sendfile upload before its sender pauses (default 1048576)"},
+    {"compress-threshold", false,
+     [](ServerConfig& c, const std::string& v) {
+       c.compress_threshold = parse_int("compress-threshold", v);
+       check_error(c.compress_threshold < 0, "--compress-threshold must be >= 0");
+     },
+     "Compress frames of at least N bytes for clients that ask, 0 = never (default 1024)"},
+    {"compress-level", false,
+     [](ServerConfig& c, const std::string& v) {
+       c.compress_level = parse_int("compress-level", v);
+       check_error(c.compress_level < 1 || c.compress_level > 9, "--compress-level must be 1..9");
+     },
+     "zlib level for negotiated compression, 1 = fastest (default 1)"},
+    {"log-mode", false,
+     [](ServerConfig& c, const std::string& v) { c.log_mode = parse_log_mode(v); },
+     "Per-message logs: sync | async | sampled | off (default sync)"},
+    {"log-sample", false,
+     [](ServerConfig& c, const std::string& v) {
+       c.log_sample = parse_int("log-sample", v);
+       check_error(c.log_sample < 1, "--log-sample must be >= 1");
+     },
+     "sampled: keep 1 in N calls per log site (default 100)"},
+    {"log-payload-max", false,
+     [](ServerConfig& c, const std::string& v) {
+       c.log_payload_max = parse_int("log-payload-max", v);
+       check_error(c.log_payload_max < 0, "--log-payload-max must be >= 0");
+     },
+     "Truncate logged client payloads to N bytes, 0 = whole (default 0)"},
+    {"stats-command", true,
+     [](ServerConfig& c, const std::string& v) { c.stats_command = parse_bool("stats-command", v); },
+     "Answer /stats from any client with the metrics dump (default off)"},
+    {"metrics-socket", false,
+     [](ServerConfig& c, const std::string& v) { c.metrics_socket = v; },
+     "Unix socket path serving Prometheus-style metrics (default off)"},
+    {"history-size", false,
+     [](ServerConfig& c, const std::string& v) {
+       c.history_size = parse_int("history-size", v);
+       check_error(c.history_size < 0, "--history-size must be >= 0");
+     },
+     "Recent broadcasts kept per channel for /history, 0 = off (default 100)"},
+    {"history-on-join", false,
+     [](ServerConfig& c, const std::string& v) {
+       c.history_on_join = parse_int("history-on-join", v);
+       check_error(c.history_on_join < 0, "--history-on-join must be >= 0");
+     },
+     "Frames of history replayed to a client on /join (default 0)"},
+    {"history-budget-bytes", false,
+     [](ServerConfig& c, const std::string& v) {
+       c.history_budget_bytes = parse_int("history-budget-bytes", v);
+       check_error(c.history_budget_bytes < 0, "--history-budget-bytes must be >= 0");
+     },
+     "Cap on bytes held by all channel histories (default 16777216)"},
+    {"message-log", false,
+     [](ServerConfig& c, const std::string& v) { c.message_log_dir = v; },
+     "Directory for the durable channel message log (default off)"},
+    {"durability", false,
+     [](ServerConfig& c, const std::string& v) { c.durability = parse_durability(v); },
+     "Message log: none | batch | per-message (default batch)"},
+    {"message-log-segment-bytes", false,
+     [](ServerConfig& c, const std::string& v) {
+       c.message_log_segment_bytes = parse_int("message-log-segment-bytes", v);
+       check_error(c.message_log_segment_bytes <= 0, "--message-log-segment-bytes must be > 0");
+     },
+     "Message log segment size before rolling to a new file (default 67108864)"},
+    {"state-dir", false,
+     [](ServerConfig& c, const std::string& v) { c.state_dir = v; },
+     "Directory for channel snapshots, restored at startup (default off)"},
+    {"snapshot-interval-s", false,
+     [](ServerConfig& c, const std::string& v) {
+       c.snapshot_interval_s = parse_int("snapshot-interval-s", v);
+       check_error(c.snapshot_interval_s < 0, "--snapshot-interval-s must be >= 0");
+     },
+     "Seconds between state snapshots, 0 = only at shutdown (default 60)"},
+  };
+  return kOptions;
+}
+
+} // namespace
+
+const char* to_string(SlowConsumerPolicy policy) {
+  switch (policy) {
+    case SlowConsumerPolicy::kDropOldest: return "drop-oldest";
+    case SlowConsumerPolicy::kDisconnect: return "disconnect";
+    case SlowConsumerPolicy::kPause: return "pause";
+  }
+  return "unknown";
+}
+
+const char* to_string(LogMode mode) {
+  switch (mode) {
+    case LogMode::kSync: return "sync";
+    case LogMode::kAsync: return "async";
+    case LogMode::kSampled: return "sampled";
+    case LogMode::kOff: return "off";
+  }
+  return "unknown";
+}
+
+const char* to_string(Durability durability) {
+  switch (durability) {
+    case Durability::kNone: return "none";
+    case Durability::kBatch: return "batch";
+    case Durability::kPerMessage: return "per-message";
+  }
+  return "unknown";
+}
+
+void print_server_usage(const char* prog_name) {
+  std::cerr << "Usage: " << prog_name << " [options]\n";
+  for (const auto& opt : options()) {
+    std::string spelling = std::string("--") + opt.name + (opt.is_flag ? "[=0|1]" : "=<value>");
+    std::cerr << "  " << spelling << std::string(spelling.size() < 28 ? 28 - spelling.size() : 1, ' ')
+              << opt.help << "\n";
+  }
+}
+
+ServerConfig parse_server_args(int argc, char* argv[]) {
+  ServerConfig config;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    check_error(arg.rfind("--", 0) != 0, "Unexpected argument: " + arg);
+
+    std::string name = arg.substr(2);
+    std::string value;
+    bool has_value = false;
+    if (size_t eq = name.find('='); eq != std::string::npos) {
+      value = name.substr(eq + 1);
+      name = name.substr(0, eq);
+      has_value = true;
+    }
+
+    bool negated = false;
+    const Option* match = nullptr;
+    for (const auto& opt : options()) {
+      if (name == opt.name) {
+        match = &opt;
+      } else if (opt.is_flag && name == std::string("no-") + opt.name) {
+        match = &opt;
+        negated = true;
+      }
+    }
+    check_error(match == nullptr, "Unknown option: --" + name);
+
+    if (match->is_flag) {
+      check_error(negated && has_value, "--" + name + " does not take a value");
+      if (!has_value) value = negated ? "0" : "1";
+    } else if (!has_value) {
+      check_error(i + 1 >= argc, "Missing value for --" + name);
+      value = argv[++i];
+    }
+    match->apply(config, value);
+  }
+  return config;
+}
+
+} // namespace tt::chat::server
@@ -0,0 +1,127 @@
+#ifndef SERVER_CONFIG_H
+#define SERVER_CONFIG_H
+
+#include <string>
+
+namespace tt::chat::server {
+
+    // What to do when a recipient's outbound queue would grow past max_queued_bytes.
+    enum class SlowConsumerPolicy {
+        kDropOldest,  // discard the oldest unsent frames for that recipient
+        kDisconnect,  // drop the recipient
+        kPause,       // queue anyway, stop reading from the sender until the queue drains
+    };
+
+    // How per-message log lines (HOT_LOG_*) are handled. Other log sites are always
+    // written synchronously; they run once per connection or command, not per message.
+    enum class LogMode {
+        kSync,     // write on the calling thread, as plain SPDLOG_* does
+        kAsync,    // format into a ring, a background thread writes
+        kSampled,  // async, and only one call in log_sample per call site is kept
+        kOff,      // drop them
+    };
+
+    // When a channel message is on disk relative to when it is delivered (--message-log).
+    enum class Durability {
+        kNone,        // written in the background, never fsynced; delivered at once
+        kBatch,       // group commit: one fsync per batch, delivered once it returns
+        kPerMessage,  // one write and fsync per message, delivered once it returns
+    };
+
+    // Runtime knobs for EpollServer. Defaults match the historical hard-coded behaviour
+    // except where a faster path is available on the running kernel.
+    struct ServerConfig {
+        int port = 8080;
+
+        // Number of event-loop threads. Each shard owns a listening socket (SO_REUSEPORT),
+        // its own ring or epoll instance and its clients.
+        int shards = 1;
+
+        // io_uring only: use multishot accept/recv backed by a provided-buffer ring.
+        // Falls back to single-shot SQEs if the kernel cannot register the ring.
+        bool multishot = true;
+
+        // io_uring only: register a sparse fixed-file table, accept directly into it and
+        // issue every client SQE with IOSQE_FIXED_FILE. Off by default for A/B runs.
+        bool fixed_files = false;
+
+        // io_uring only: frames of at least this many bytes go out with IORING_OP_SEND_ZC
+        // instead of a copying send. 0 disables zero-copy sends.
+        int zc_threshold = 32768;
+
+        // Low-latency knobs, all off by default. sqpoll (io_uring only) moves submission
+        // to a kernel thread that polls the SQ for sqpoll_idle_ms before sleeping, pinned
+        // to sqpoll_cpu + shard index when sqpoll_cpu >= 0. busy_poll_us sets SO_BUSY_POLL
+        // on the listening socket, which accepted sockets inherit. spin_us lets the loop
+        // poll for completions for up to that long before blocking.
+        bool sqpoll = false;
+        int sqpoll_idle_ms = 100;
+        int sqpoll_cpu = -1;
+        int busy_poll_us = 0;
+        int spin_us = 0;
+
+        // Output coalescing: frames queued for a client during one loop iteration leave
+        // in one vectored send at its end, instead of one send per frame. coalesce_us
+        // holds a client's output up to that much longer to batch across iterations;
+        // coalesce_sends=false sends every frame as soon as it is queued.
+        bool coalesce_sends = true;
+        int coalesce_us = 0;
+
+        // Per-connection cap on bytes queued for sending. Must fit the largest frame.
+        int max_queued_bytes = 4 * 1024 * 1024;
+        SlowConsumerPolicy slow_consumer = SlowConsumerPolicy::kDropOldest;
+        // Per /sendfile upload: bytes of relayed chunk frames not yet written to every
+        // recipient before the sender's reads pause. Bounds the memory of a transfer.
+        int file_window_bytes = 1024 * 1024;
+
+        // "/proto 2 deflate": broadcasts of at least compress_threshold body bytes go to
+        // the clients that asked compressed, at zlib compress_level. 0 refuses to negotiate.
+        int compress_threshold = 1024;
+        int compress_level = 1;
+
+        // Per-message logging (see hot-log.h). log_payload_max truncates logged client
+        // payloads, 0 = log them whole; async records are capped at 240 bytes regardless.
+        LogMode log_mode = LogMode::kSync;
+        int log_sample = 100;
+        int log_payload_max = 0;
+
+        // /stats answers any client with the Prometheus dump of every shard's counters, so
+        // it is off unless asked for. metrics_socket, when set, is a Unix socket path
+        // serving the same dump to each connection: the normal path for local scrapers.
+        bool stats_command = false;
+        std::string metrics_socket;
+
+        // Each channel keeps its last history_size broadcasts for /history and replay on
+        // join (history_on_join frames, 0 = none). All channels together hold at most
+        // history_budget_bytes; 0 frames disables history.
+        int history_size = 100;
+        int history_on_join = 0;
+        int history_budget_bytes = 16 * 1024 * 1024;
+
+        // Directory for the append-only channel message log, one segment series per
+        // shard (see message-log.h). Empty disables the log.
+        std::string message_log_dir;
+        Durability durability = Durability::kBatch;
+        int message_log_segment_bytes = 64 * 1024 * 1024;
+
+        // Directory for the channel snapshot and its journal (see state-store.h). Empty
+        // disables persistence. 0 snapshot_interval_s snapshots at shutdown only.
+        std::string state_dir;
+        int snapshot_interval_s = 60;
+    };
+
+    /**
+     * Parses "--key=value", "--key value", "--flag" and "--no-flag" style arguments.
+     * @throws std::runtime_error on unknown options or malformed values.
+     */
+    ServerConfig parse_server_args(int argc, char* argv[]);
+
+    void print_server_usage(const char* prog_name);
+
+    const char* to_string(SlowConsumerPolicy policy);
+    const char* to_string(LogMode mode);
+    const char* to_string(Durability durability);
+
+} // namespace tt::chat::server
+
+#endif // SERVER_CONFIG_H
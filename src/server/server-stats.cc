@@ -0,0 +1,252 @@
+#include "server-stats.h"
+
+#include <iterator>
+
+#include <spdlog/spdlog.h>
+
+#include "alloc-stats.h"
+
+namespace tt::chat::server {
+
+namespace {
+
+struct CounterMetric {
+  const char* name;
+  const char* type;  // "counter", or "gauge" for values that go down or are sampled
+  const char* help;
+  Counter ServerStats::*member;
+};
+
+constexpr CounterMetric kCounterMetrics[] = {
+  {"chat_connections_accepted_total", "counter", "Accepted client connections.", &ServerStats::connections_accepted},
+  {"chat_recv_completions_total", "counter", "Recv CQEs (io_uring) or recv calls (epoll).", &ServerStats::recv_completions},
+  {"chat_bytes_received_total", "counter", "Bytes read from clients.", &ServerStats::bytes_received},
+  {"chat_frames_received_total", "counter", "Frames decoded from clients.", &ServerStats::messages_received},
+  {"chat_loop_iterations_total", "counter", "Event loop wakeups.", &ServerStats::loop_iterations},
+  {"chat_submit_calls_total", "counter", "io_uring submit calls.", &ServerStats::submit_calls},
+  {"chat_sqes_submitted_total", "counter", "SQEs handed to the kernel.", &ServerStats::sqes_submitted},
+  {"chat_sq_full_flushes_total", "counter", "Early submits forced by a full SQ.", &ServerStats::sq_full_flushes},
+  {"chat_frames_encoded_total", "counter", "Outgoing frames serialized.", &ServerStats::frames_encoded},
+  {"chat_bytes_encoded_total", "counter", "Bytes written while serializing outgoing frames.", &ServerStats::bytes_encoded},
+  {"chat_frames_sent_total", "counter", "Frames queued to recipients.", &ServerStats::frames_sent},
+  {"chat_bytes_sent_total", "counter", "Bytes written to clients.", &ServerStats::bytes_sent},
+  {"chat_send_calls_total", "counter", "sendmsg calls (epoll) or send SQEs (io_uring).", &ServerStats::send_calls},
+  {"chat_syscalls_total", "counter", "Event loop syscalls: waits, reads and sends (epoll) or io_uring_enter.", &ServerStats::syscalls},
+  {"chat_zc_sends_total", "counter", "Zero-copy sends.", &ServerStats::zc_sends},
+  {"chat_zc_copied_total", "counter", "Zero-copy sends the kernel copied anyway.", &ServerStats::zc_copied},
+  {"chat_zc_fallbacks_total", "counter", "Zero-copy sends rejected and retried as plain sends.", &ServerStats::zc_fallbacks},
+  {"chat_queued_bytes", "gauge", "Bytes waiting in outbound queues.", &ServerStats::queued_bytes},
+  {"chat_peak_queued_bytes", "gauge", "Deepest single outbound queue, in bytes.", &ServerStats::peak_queued_bytes},
+  {"chat_peak_queued_frames", "gauge", "Deepest single outbound queue, in frames.", &ServerStats::peak_queued_frames},
+  {"chat_partial_sends_total", "counter", "Short writes resumed from the queue.", &ServerStats::partial_sends},
+  {"chat_frames_dropped_total", "counter", "Frames dropped by the drop-oldest policy.", &ServerStats::frames_dropped},
+  {"chat_slow_consumer_disconnects_total", "counter", "Clients dropped by the disconnect policy.", &ServerStats::slow_consumer_disconnects},
+  {"chat_read_pauses_total", "counter", "Senders paused by the pause policy.", &ServerStats::read_pauses},
+  {"chat_spin_hits_total", "counter", "Waits satisfied while spinning, before blocking.", &ServerStats::spin_hits},
+  {"chat_spin_misses_total", "counter", "Spins that ran out of budget and blocked.", &ServerStats::spin_misses},
+  {"chat_cross_shard_forwarded_total", "counter", "Broadcast frames pushed to other shards.", &ServerStats::cross_shard_forwarded},
+  {"chat_cross_shard_delivered_total", "counter", "Frames received from other shards.", &ServerStats::cross_shard_delivered},
+  {"chat_mailbox_full_waits_total", "counter", "Cross-shard pushes that found the peer's queue full.", &ServerStats::mailbox_full_waits},
+  {"chat_dms_sent_total", "counter", "Direct messages delivered to a local recipient.", &ServerStats::dms_sent},
+  {"chat_dms_forwarded_total", "counter", "Direct messages pushed to the recipient's shard.", &ServerStats::dms_forwarded},
+  {"chat_dms_undeliverable_total", "counter", "Direct messages with no live recipient.", &ServerStats::dms_undeliverable},
+  {"chat_files_started_total", "counter", "File uploads accepted.", &ServerStats::files_started},
+  {"chat_files_completed_total", "counter", "File uploads relayed in full.", &ServerStats::files_completed},
+  {"chat_files_aborted_total", "counter", "File uploads cut short.", &ServerStats::files_aborted},
+  {"chat_file_chunks_relayed_total", "counter", "File chunks relayed.", &ServerStats::file_chunks_relayed},
+  {"chat_file_bytes_relayed_total", "counter", "File bytes relayed.", &ServerStats::file_bytes_relayed},
+  {"chat_file_chunks_dropped_total", "counter", "File chunks with no upload in progress.", &ServerStats::file_chunks_dropped},
+  {"chat_file_window_pauses_total", "counter", "Uploads paused on a full window.", &ServerStats::file_window_pauses},
+  {"chat_frames_compressed_total", "counter", "Broadcasts compressed for compressing members.", &ServerStats::frames_compressed},
+  {"chat_compress_bytes_in_total", "counter", "Frame bodies that were compressed.", &ServerStats::compress_bytes_in},
+  {"chat_compress_bytes_out_total", "counter", "Compressed payload bytes produced.", &ServerStats::compress_bytes_out},
+  {"chat_compress_skipped_total", "counter", "Bodies sent plain because they did not shrink.", &ServerStats::compress_skipped},
+  {"chat_compress_ns_total", "counter", "Time spent compressing, in nanoseconds.", &ServerStats::compress_ns},
+  {"chat_compress_wire_bytes_saved_total", "counter", "Bytes compression kept off the wire, over all recipients.", &ServerStats::compress_wire_bytes_saved},
+  {"chat_frames_decompressed_total", "counter", "Compressed frames received from clients.", &ServerStats::frames_decompressed},
+  {"chat_decompress_bytes_in_total", "counter", "Compressed payload bytes received.", &ServerStats::decompress_bytes_in},
+  {"chat_decompress_bytes_out_total", "counter", "Bytes they inflated to.", &ServerStats::decompress_bytes_out},
+  {"chat_decompress_ns_total", "counter", "Time spent decompressing, in nanoseconds.", &ServerStats::decompress_ns},
+  {"chat_decompress_errors_total", "counter", "Compressed frames rejected.", &ServerStats::decompress_errors},
+  {"chat_history_replays_total", "counter", "History replays sent (/history, join).", &ServerStats::history_replays},
+  {"chat_history_frames_replayed_total", "counter", "Broadcasts carried by history replays.", &ServerStats::history_frames_replayed},
+  {"chat_log_records_total", "counter", "Channel messages appended to the message log.", &ServerStats::log_records},
+  {"chat_log_bytes_total", "counter", "Bytes written to the message log.", &ServerStats::log_bytes},
+  {"chat_log_commits_total", "counter", "Message log batches written.", &ServerStats::log_commits},
+  {"chat_log_syncs_total", "counter", "Message log fsyncs.", &ServerStats::log_syncs},
+  {"chat_log_errors_total", "counter", "Failed async message log writes.", &ServerStats::log_errors},
+};
+
+void append_header(std::string& out, const char* name, const char* type, const char* help) {
+  fmt::format_to(std::back_inserter(out), "# HELP {} {}\n# TYPE {} {}\n", name, help, name, type);
+}
+
+// Cumulative buckets up to the highest non-empty one, then +Inf, _sum and _count.
+void append_histogram(std::string& out, const char* name, const std::string& labels, const Histogram& h) {
+  size_t last = 0;
+  for (size_t i = 0; i < Histogram::kBuckets; ++i) {
+    if (h.bucket(i) > 0) last = i;
+  }
+  std::uint64_t cumulative = 0;
+  for (size_t i = 0; i <= last && i + 1 < Histogram::kBuckets; ++i) {
+    cumulative += h.bucket(i);
+    fmt::format_to(std::back_inserter(out), "{}_bucket{{{},le=\"{}\"}} {}\n", name, labels,
+                   Histogram::upper_bound(i), cumulative);
+  }
+  fmt::format_to(std::back_inserter(out), "{}_bucket{{{},le=\"+Inf\"}} {}\n{}_sum{{{}}} {}\n{}_count{{{}}} {}\n",
+                 name, labels, h.count(), name, labels, h.sum(), name, labels, h.count());
+}
+
+} // namespace
+
+void ServerStats::on_message(std::uint64_t heap_allocations_now) {
+  if (messages_received++ == 0) {
+    allocations_at_first_message = heap_allocations_now;
+  }
+}
+
+double ServerStats::per_frame_sent(const Counter& counter) const {
+  std::uint64_t frames = frames_sent;
+  return frames > 0 ? static_cast<double>(counter) / static_cast<double>(frames) : 0.0;
+}
+
+double ServerStats::compression_ratio() const {
+  std::uint64_t out = compress_bytes_out;
+  return out > 0 ? static_cast<double>(compress_bytes_in) / static_cast<double>(out) : 0.0;
+}
+
+void ServerStats::log_summary(std::uint64_t heap_allocations_now) const {
+  double allocs_per_msg = 0;
+  double msgs_per_recv = 0;
+  if (recv_completions > 0) {
+    msgs_per_recv = static_cast<double>(messages_received) / static_cast<double>(recv_completions);
+  }
+  if (messages_received > 0) {
+    allocs_per_msg = static_cast<double>(heap_allocations_now - allocations_at_first_message) /
+                     static_cast<double>(messages_received);
+  }
+  if (kAllocStatsEnabled) {
+    SPDLOG_INFO("Server stats: connections={} recv_completions={} bytes_received={} "
+                "messages_received={} messages/recv={:.2f} allocations/message={:.2f}",
+                connections_accepted, recv_completions, bytes_received,
+                messages_received, msgs_per_recv, allocs_per_msg);
+  } else {
+    SPDLOG_INFO("Server stats: connections={} recv_completions={} bytes_received={} "
+                "messages_received={} messages/recv={:.2f}",
+                connections_accepted, recv_completions, bytes_received,
+                messages_received, msgs_per_recv);
+  }
+  SPDLOG_INFO("Send stats: frames_encoded={} bytes_encoded={} frames_sent={} "
+              "bytes_encoded/frame_sent={:.1f} send_calls={} sends/frame={:.3f} syscalls/frame={:.3f} "
+              "zc_sends={} zc_copied={} zc_fallbacks={}",
+              frames_encoded, bytes_encoded, frames_sent,
+              frames_sent ? static_cast<double>(bytes_encoded) / frames_sent : 0.0,
+              send_calls, per_frame_sent(send_calls), per_frame_sent(syscalls),
+              zc_sends, zc_copied, zc_fallbacks);
+  SPDLOG_INFO("Queue stats: queued_bytes={} peak_queued_bytes={} peak_queued_frames={} "
+              "partial_sends={} frames_dropped={} slow_consumer_disconnects={} read_pauses={}",
+              queued_bytes, peak_queued_bytes, peak_queued_frames, partial_sends,
+              frames_dropped, slow_consumer_disconnects, read_pauses);
+  if (spin_hits > 0 || spin_misses > 0) {
+    SPDLOG_INFO("Wait stats: spin_hits={} spin_misses={} spin_hit_rate={:.2f}",
+                spin_hits, spin_misses,
+                static_cast<double>(spin_hits) / static_cast<double>(spin_hits + spin_misses));
+  }
+  if (cross_shard_forwarded > 0 || cross_shard_delivered > 0) {
+    SPDLOG_INFO("Shard stats: cross_shard_forwarded={} cross_shard_delivered={} mailbox_full_waits={}",
+                cross_shard_forwarded, cross_shard_delivered, mailbox_full_waits);
+  }
+  if (dms_sent > 0 || dms_forwarded > 0 || dms_undeliverable > 0) {
+    SPDLOG_INFO("DM stats: sent={} forwarded={} undeliverable={}", dms_sent, dms_forwarded, dms_undeliverable);
+  }
+  if (files_started > 0 || file_chunks_dropped > 0) {
+    SPDLOG_INFO("File stats: started={} completed={} aborted={} chunks={} bytes={} chunks_dropped={} "
+                "window_pauses={}", files_started, files_completed, files_aborted, file_chunks_relayed,
+                file_bytes_relayed, file_chunks_dropped, file_window_pauses);
+  }
+  if (frames_compressed > 0 || compress_skipped > 0 || frames_decompressed > 0 || decompress_errors > 0) {
+    std::uint64_t attempts = frames_compressed + compress_skipped;
+    SPDLOG_INFO("Compression stats: frames={} skipped={} bytes_in={} bytes_out={} ratio={:.2f} "
+                "ns/frame={:.0f} wire_bytes_saved={} decompressed={} inflated_bytes={} errors={}",
+                frames_compressed, compress_skipped, compress_bytes_in, compress_bytes_out,
+                compression_ratio(), attempts ? static_cast<double>(compress_ns) / attempts : 0.0,
+                compress_wire_bytes_saved, frames_decompressed, decompress_bytes_out, decompress_errors);
+  }
+  if (log_commits > 0) {
+    SPDLOG_INFO("Durability stats: records={} bytes={} commits={} syncs={} records/commit={:.2f} errors={}",
+                log_records, log_bytes, log_commits, log_syncs,
+                static_cast<double>(log_records) / log_commits, log_errors);
+  }
+  if (submit_calls > 0) {
+    SPDLOG_INFO("Submission stats: loop_iterations={} submit_calls={} sqes_submitted={} "
+                "sq_full_flushes={} submits/iteration={:.2f} sqes/submit={:.2f}",
+                loop_iterations, submit_calls, sqes_submitted, sq_full_flushes,
+                loop_iterations ? static_cast<double>(submit_calls) / loop_iterations : 0.0,
+                static_cast<double>(sqes_submitted) / submit_calls);
+    SPDLOG_INFO("Pool stats: contexts_in_use={} context_slabs={} recv_buffer_slabs={}",
+                contexts_in_use, context_slabs, recv_buffer_slabs);
+  }
+}
+
+std::string ServerStats::render_prometheus(const std::vector<const ServerStats*>& shards) {
+  std::string out;
+  for (const CounterMetric& metric : kCounterMetrics) {
+    append_header(out, metric.name, metric.type, metric.help);
+    for (size_t shard = 0; shard < shards.size(); ++shard) {
+      fmt::format_to(std::back_inserter(out), "{}{{shard=\"{}\"}} {}\n", metric.name, shard,
+                     (shards[shard]->*metric.member).load());
+    }
+  }
+
+  // Derived, so a dashboard need not divide two counters itself.
+  append_header(out, "chat_syscalls_per_frame", "gauge", "Event loop syscalls per frame delivered to a client.");
+  for (size_t shard = 0; shard < shards.size(); ++shard) {
+    fmt::format_to(std::back_inserter(out), "chat_syscalls_per_frame{{shard=\"{}\"}} {:.3f}\n", shard,
+                   shards[shard]->per_frame_sent(shards[shard]->syscalls));
+  }
+  append_header(out, "chat_send_calls_per_frame", "gauge", "Sends issued per frame delivered to a client.");
+  for (size_t shard = 0; shard < shards.size(); ++shard) {
+    fmt::format_to(std::back_inserter(out), "chat_send_calls_per_frame{{shard=\"{}\"}} {:.3f}\n", shard,
+                   shards[shard]->per_frame_sent(shards[shard]->send_calls));
+  }
+  append_header(out, "chat_compression_ratio", "gauge",
+                "Uncompressed over compressed bytes of the broadcasts sent compressed.");
+  for (size_t shard = 0; shard < shards.size(); ++shard) {
+    fmt::format_to(std::back_inserter(out), "chat_compression_ratio{{shard=\"{}\"}} {:.3f}\n", shard,
+                   shards[shard]->compression_ratio());
+  }
+
+  struct HistogramMetric {
+    const char* name;
+    const char* help;
+    Histogram ServerStats::*member;
+  };
+  static constexpr HistogramMetric kHistograms[] = {
+    {"chat_completions_per_loop", "CQEs (io_uring) or ready fds (epoll) per loop wakeup.", &ServerStats::completions_per_loop},
+    {"chat_send_queue_depth_bytes", "Recipient's queued bytes after each enqueue.", &ServerStats::send_queue_depth},
+    {"chat_fanout_size", "Local recipients per broadcast.", &ServerStats::fanout_size},
+    {"chat_frames_per_send", "Frames gathered into each send.", &ServerStats::frames_per_send},
+    {"chat_compress_latency_ns", "Time per compression attempt.", &ServerStats::compress_latency_ns},
+    {"chat_log_batch_records", "Records per message log commit.", &ServerStats::log_batch_records},
+    {"chat_log_commit_latency_us", "Message log commit time, submit to durable.", &ServerStats::log_commit_latency_us},
+  };
+  for (const HistogramMetric& metric : kHistograms) {
+    append_header(out, metric.name, "histogram", metric.help);
+    for (size_t shard = 0; shard < shards.size(); ++shard) {
+      append_histogram(out, metric.name, fmt::format("shard=\"{}\"", shard), shards[shard]->*metric.member);
+    }
+  }
+
+  append_header(out, "chat_command_latency_ns", "histogram", "Time spent in each command handler.");
+  for (size_t shard = 0; shard < shards.size(); ++shard) {
+    for (size_t c = 0; c < static_cast<size_t>(Command::kCount); ++c) {
+      const Histogram& h = shards[shard]->command_latency_ns[c];
+      if (h.count() == 0) continue;
+      append_histogram(out, "chat_command_latency_ns",
+                       fmt::format("shard=\"{}\",command=\"{}\"", shard, command_name(static_cast<Command>(c))), h);
+    }
+  }
+  return out;
+}
+
+} // namespace tt::chat::server
@@ -0,0 +1,115 @@
+#ifndef SERVER_STATS_H
+#define SERVER_STATS_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "command-parser.h"
+#include "metrics.h"
+
+namespace tt::chat::server {
+
+    // Counters and histograms owned by the event loop thread. Logged once when the server
+    // stops so load-test runs can be compared without attaching a profiler, and readable
+    // from any thread while it runs (/stats, the metrics socket).
+    struct ServerStats {
+        Counter connections_accepted;
+        Counter recv_completions;  // recv CQEs (uring) or recv syscalls (epoll)
+        Counter bytes_received;
+        Counter messages_received;
+
+        Counter loop_iterations;  // event loop wakeups
+        Counter submit_calls;     // io_uring_submit*/io_uring_enter calls
+        Counter sqes_submitted;
+        Counter sq_full_flushes;  // early flushes forced by a full SQ
+
+        Counter frames_encoded;   // outgoing frames serialized (once per broadcast)
+        Counter bytes_encoded;    // bytes written while serializing them
+        Counter frames_sent;      // per-recipient sends referencing those frames
+        Counter bytes_sent;       // bytes the kernel accepted from the outbound queues
+        Counter send_calls;       // sendmsg calls (epoll) or send SQEs (uring), batches included
+        Counter syscalls;         // epoll_wait/recv/sendmsg (epoll) or io_uring_enter (uring) calls
+        Counter zc_sends;         // sends issued as IORING_OP_SEND_ZC
+        Counter zc_copied;        // zero-copy sends the kernel had to copy anyway
+        Counter zc_fallbacks;     // zero-copy sends rejected and retried as plain sends
+
+        Counter queued_bytes;       // bytes currently waiting in all outbound queues
+        Counter peak_queued_bytes;  // deepest single outbound queue seen, in bytes
+        Counter peak_queued_frames; // ... and in frames
+        Counter partial_sends;      // short writes resumed from the queue
+        Counter frames_dropped;     // drop-oldest policy
+        Counter slow_consumer_disconnects;
+        Counter read_pauses;        // pause policy: times a sender's reads were paused
+
+        // io_uring context/buffer pools, sampled at shutdown. Slab counts that stay flat
+        // while message counts grow mean the I/O path did no heap allocation.
+        Counter contexts_in_use;
+        Counter context_slabs;
+        Counter recv_buffer_slabs;
+
+        Counter spin_hits;    // waits satisfied while spinning, before blocking
+        Counter spin_misses;  // spins that ran out of budget and blocked
+
+        Counter cross_shard_forwarded;  // broadcast frames pushed to other shards
+        Counter cross_shard_delivered;  // frames received from other shards
+        Counter mailbox_full_waits;     // pushes that found a peer's queue full
+
+        Counter dms_sent;           // direct messages delivered to a local recipient
+        Counter dms_forwarded;      // direct messages pushed to the recipient's shard
+        Counter dms_undeliverable;  // unknown recipient, or gone before delivery
+
+        Counter files_started;        // /sendfile uploads accepted
+        Counter files_completed;
+        Counter files_aborted;        // sender left, or sent more than it announced
+        Counter file_chunks_relayed;  // chunks received and passed on
+        Counter file_bytes_relayed;   // file bytes in them
+        Counter file_chunks_dropped;  // chunks with no upload in progress
+        Counter file_window_pauses;   // times an upload filled its window
+
+        Counter frames_compressed;         // broadcasts compressed (once each, shared by members)
+        Counter compress_bytes_in;         // bodies of the frames_compressed ...
+        Counter compress_bytes_out;        // ... and their compressed payloads
+        Counter compress_skipped;          // offered but sent plain: it did not shrink
+        Counter compress_ns;               // time spent compressing, skipped attempts included
+        Counter compress_wire_bytes_saved; // per recipient of a compressed frame
+        Counter frames_decompressed;       // compressed frames received from clients
+        Counter decompress_bytes_in;
+        Counter decompress_bytes_out;
+        Counter decompress_ns;
+        Counter decompress_errors;         // malformed, oversized, or never negotiated
+        Histogram compress_latency_ns;     // per compression attempt
+
+        Counter history_replays;         // /history and join replays sent
+        Counter history_frames_replayed; // broadcasts they carried
+
+        Counter log_records;       // channel messages appended to the message log
+        Counter log_bytes;         // bytes written to it
+        Counter log_commits;       // batches written
+        Counter log_syncs;         // fsyncs issued
+        Counter log_errors;        // failed async writes (retried synchronously)
+        Histogram log_batch_records;
+        Histogram log_commit_latency_us;  // batch handed to the kernel -> on disk
+
+        Histogram completions_per_loop;  // CQEs (uring) or ready fds (epoll) per wakeup
+        Histogram send_queue_depth;      // recipient's queued bytes after each enqueue
+        Histogram fanout_size;           // local recipients per broadcast
+        Histogram frames_per_send;       // frames gathered into each send
+        Histogram command_latency_ns[static_cast<size_t>(Command::kCount)];
+
+        // Heap allocation count sampled at the first received message, so connection
+        // setup and ring registration are not charged to the per-message figure.
+        std::uint64_t allocations_at_first_message = 0;
+
+        void on_message(std::uint64_t heap_allocations_now);
+        void log_summary(std::uint64_t heap_allocations_now) const;
+        double compression_ratio() const;  // compress_bytes_in / compress_bytes_out
+        double per_frame_sent(const Counter& counter) const;  // counter / frames_sent
+
+        // Prometheus text exposition of every shard's stats, labelled by shard index.
+        static std::string render_prometheus(const std::vector<const ServerStats*>& shards);
+    };
+
+} // namespace tt::chat::server
+
+#endif // SERVER_STATS_H
@@ -0,0 +1,127 @@
+#include "shard-directory.h"
+
+#include <string_view>
+
+namespace tt::chat::server {
+
+bool ShardDirectory::claim_username(ClientKey client, std::uint64_t conn_id, const std::string& name) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (owners_.count(name)) {
+    return false;
+  }
+  if (auto it = usernames_.find(client); it != usernames_.end()) {
+    owners_.erase(it->second);
+    user_index_.erase(it->second);
+  }
+  owners_[name] = client;
+  usernames_[client] = name;
+  user_index_.insert(name, {static_cast<int>(client >> 32), static_cast<int>(static_cast<std::uint32_t>(client)), conn_id});
+  return true;
+}
+
+void ShardDirectory::release_client(ClientKey client) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (auto it = usernames_.find(client); it != usernames_.end()) {
+    owners_.erase(it->second);
+    user_index_.erase(it->second);
+    usernames_.erase(it);
+  }
+}
+
+ChannelEntry* ShardDirectory::create_channel(const std::string& name) {
+  ChannelEntry* entry;
+  StateJournal* journal;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto [it, inserted] = channels_.try_emplace(name);
+    if (!inserted) {
+      return nullptr;
+    }
+    it->second = std::make_unique<ChannelEntry>(next_channel_id_++, name);
+    entry = it->second.get();
+    journal = journal_;
+    if (journal) {
+      journal->append(StateOp::kCreateChannel, name);
+    }
+  }
+  // Queued in order under the lock; written outside it, so no other shard's directory
+  // call waits on the disk.
+  if (journal) {
+    journal->flush();
+  }
+  return entry;
+}
+
+ChannelEntry* ShardDirectory::find_channel(const std::string& name) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = channels_.find(name);
+  return it == channels_.end() ? nullptr : it->second.get();
+}
+
+void ShardDirectory::join(ChannelEntry* channel, int shard, ClientKey client) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (channel->members.insert(client).second && channel->shard_members[shard]++ == 0) {
+    channel->shard_mask.fetch_or(std::uint64_t{1} << shard, std::memory_order_release);
+  }
+}
+
+void ShardDirectory::leave(ChannelEntry* channel, int shard, ClientKey client) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (channel->members.erase(client) && --channel->shard_members[shard] == 0) {
+    channel->shard_mask.fetch_and(~(std::uint64_t{1} << shard), std::memory_order_release);
+  }
+}
+
+std::vector<std::string> ShardDirectory::list_channels() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::vector<std::string> result;
+  for (const auto& [name, _] : channels_) result.push_back(name);
+  return result;
+}
+
+std::vector<std::string> ShardDirectory::member_names(ChannelEntry* channel) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::vector<std::string> result;
+  for (ClientKey client : channel->members) {
+    auto it = usernames_.find(client);
+    result.push_back(it == usernames_.end() ? std::string() : it->second);
+  }
+  return result;
+}
+
+void ShardDirectory::set_journal(StateJournal* journal) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  journal_ = journal;
+}
+
+ChannelEntry* ShardDirectory::restore_channel(std::string_view name) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto [it, inserted] = channels_.try_emplace(std::string(name));
+  if (!inserted) {
+    return nullptr;
+  }
+  it->second = std::make_unique<ChannelEntry>(next_channel_id_++, it->first);
+  return it->second.get();
+}
+
+DirectoryState ShardDirectory::capture_state() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  DirectoryState state;
+  // Entries are never destroyed and their names never change, so the pointers stay
+  // good after the lock is released.
+  state.channels.resize(next_channel_id_);
+  for (const auto& [_, entry] : channels_) {
+    state.channels[entry->id] = entry.get();
+  }
+  if (journal_) {
+    state.journal_generation = journal_->rotate();
+  }
+  return state;
+}
+
+size_t ShardDirectory::channel_count() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return channels_.size();
+}
+
+} // namespace tt::chat::server
@@ -0,0 +1,109 @@
+#ifndef SHARD_DIRECTORY_H
+#define SHARD_DIRECTORY_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "channel-history.h"
+#include "state-journal.h"
+#include "username-index.h"
+
+namespace tt::chat::server {
+
+    // A client is identified across shards by its shard and its shard-local fd (or
+    // fixed-file slot, which is only unique within one ring).
+    using ClientKey = std::uint64_t;
+
+    inline ClientKey make_client_key(int shard, int fd) {
+        return (static_cast<std::uint64_t>(shard) << 32) | static_cast<std::uint32_t>(fd);
+    }
+
+    constexpr int kMaxShards = 64;
+
+    // The message log and the state journal store a channel name's length in 16 bits.
+    constexpr size_t kMaxChannelNameLength = 0xffff;
+
+    // Channels are interned to small dense ids when created, so per-shard member tables
+    // can be plain arrays; names are only looked up by /create and /join.
+    using ChannelId = std::uint32_t;
+
+    // A channel as seen by every shard. Entries are never destroyed, so shards may cache
+    // the pointer. shard_mask is read without the directory lock on the broadcast path.
+    struct ChannelEntry {
+        ChannelEntry(ChannelId channel_id, std::string channel_name)
+            : id(channel_id), name(std::move(channel_name)) {}
+
+        const ChannelId id;
+        const std::string name;
+        std::atomic<std::uint64_t> shard_mask{0};  // bit i: shard i has local members
+        ChannelHistory history;                    // has its own lock
+
+        // Guarded by the directory mutex.
+        std::set<ClientKey> members;
+        int shard_members[kMaxShards] = {};
+    };
+
+    // What a snapshot keeps of the directory (see state-store.h).
+    struct DirectoryState {
+        std::vector<const ChannelEntry*> channels;  // indexed by id
+        std::uint64_t journal_generation = 0;       // first journal the state does not cover
+    };
+
+    /**
+     * Control plane shared by all shards: channel existence and membership, and the
+     * username registry. Every call takes one mutex; it is only used by commands
+     * (/name, /create, /join, /list, /users) and connects/disconnects, never per message.
+     */
+    class ShardDirectory {
+    public:
+        // Returns false if the name is taken. On success any previous name of `client`
+        // is released. `conn_id` is recorded in the username index.
+        bool claim_username(ClientKey client, std::uint64_t conn_id, const std::string& name);
+        void release_client(ClientKey client);
+        // The client currently holding `name`, for direct messages. Does not take the
+        // directory lock (see username-index.h).
+        std::optional<UserLocation> find_user(std::string_view name) const { return user_index_.find(name); }
+
+        // Returns nullptr if a channel with that name already exists.
+        ChannelEntry* create_channel(const std::string& name);
+        ChannelEntry* find_channel(const std::string& name);
+        void join(ChannelEntry* channel, int shard, ClientKey client);
+        void leave(ChannelEntry* channel, int shard, ClientKey client);
+
+        std::vector<std::string> list_channels();
+        // Usernames of the channel's members; members without one yield "".
+        std::vector<std::string> member_names(ChannelEntry* channel);
+
+        // Persistence (state-store.h). Once a journal is set, every channel created is
+        // appended to it. Usernames are not kept: nothing identifies a returning client,
+        // so a restored name could not be reserved for it. restore_channel runs before
+        // any shard starts and is not journaled.
+        void set_journal(StateJournal* journal);
+        // Returns nullptr if the channel already exists; ids are handed out in order.
+        ChannelEntry* restore_channel(std::string_view name);
+        // Copies the state under the lock and, if a journal is set, rotates it there, so
+        // the copy and the new journal generation meet exactly.
+        DirectoryState capture_state();
+        size_t channel_count();
+
+    private:
+        std::mutex mutex_;
+        std::unordered_map<std::string, std::unique_ptr<ChannelEntry>> channels_;
+        ChannelId next_channel_id_ = 0;
+        std::unordered_map<std::string, ClientKey> owners_;      // username -> client
+        std::unordered_map<ClientKey, std::string> usernames_;  // client -> username
+        UsernameIndex user_index_;                              // owners_, readable lock-free of mutex_
+        StateJournal* journal_ = nullptr;
+    };
+
+} // namespace tt::chat::server
+
+#endif // SHARD_DIRECTORY_H
@@ -0,0 +1,64 @@
+#include "shard-group.h"
+#include "../utils.h"
+
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <cstdint>
+#include <iterator>
+
+namespace tt::chat::server {
+
+ShardMailbox::ShardMailbox(int num_shards) {
+  for (int i = 0; i < num_shards; ++i) {
+    queues_.push_back(std::make_unique<SpscQueue<CrossShardMessage>>(kQueueCapacity));
+  }
+  event_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  check_error(event_fd_ < 0, "eventfd failed");
+}
+
+ShardMailbox::~ShardMailbox() {
+  close(event_fd_);
+}
+
+void ShardMailbox::notify() {
+  std::uint64_t one = 1;
+  // EAGAIN means the counter is saturated, i.e. a wakeup is pending anyway.
+  [[maybe_unused]] ssize_t ret = write(event_fd_, &one, sizeof(one));
+}
+
+void ShardMailbox::consume_notification() {
+  std::uint64_t count;
+  [[maybe_unused]] ssize_t ret = read(event_fd_, &count, sizeof(count));
+}
+
+ShardGroup::ShardGroup(int num_shards, size_t history_budget_bytes)
+    : history_budget_(history_budget_bytes), stats_(num_shards, nullptr) {
+  check_error(num_shards < 1 || num_shards > kMaxShards, "invalid shard count");
+  for (int i = 0; i < num_shards; ++i) {
+    mailboxes_.push_back(std::make_unique<ShardMailbox>(num_shards));
+  }
+}
+
+void ShardGroup::notify_all() {
+  for (auto& mailbox : mailboxes_) {
+    mailbox->notify();
+  }
+}
+
+std::string ShardGroup::render_metrics() const {
+  std::string out = ServerStats::render_prometheus(stats_);
+  fmt::format_to(std::back_inserter(out),
+                 "# HELP chat_history_bytes Bytes held by all channel histories.\n"
+                 "# TYPE chat_history_bytes gauge\nchat_history_bytes {}\n"
+                 "# HELP chat_history_budget_bytes Cap on chat_history_bytes.\n"
+                 "# TYPE chat_history_budget_bytes gauge\nchat_history_budget_bytes {}\n"
+                 "# HELP chat_history_frames Frames held by all channel histories.\n"
+                 "# TYPE chat_history_frames gauge\nchat_history_frames {}\n"
+                 "# HELP chat_history_rejected_total Broadcasts not kept because the budget was spent.\n"
+                 "# TYPE chat_history_rejected_total counter\nchat_history_rejected_total {}\n",
+                 history_budget_.used(), history_budget_.limit(), history_budget_.frames(),
+                 history_budget_.rejected());
+  return out;
+}
+
+} // namespace tt::chat::server
@@ -0,0 +1,94 @@
+#ifndef SHARD_GROUP_H
+#define SHARD_GROUP_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "server-stats.h"
+#include "shard-directory.h"
+#include "shared-frame.h"
+#include "spsc-queue.h"
+
+namespace tt::chat::server {
+
+    // A broadcast forwarded to another shard: the frame is already encoded (v1), the
+    // receiving shard only fans it out to its own members of the channel. A message
+    // with no channel is for one client of the receiving shard (a direct message, or a
+    // file sent to a user), which drops it if that fd now belongs to a different
+    // connection. opcode and transfer are carried into the receiver's FanoutFrames.
+    struct CrossShardMessage {
+        ChannelEntry* channel = nullptr;
+        SharedFrame frame;
+        int target_fd = -1;
+        std::uint64_t target_conn_id = 0;
+        net::Opcode opcode = net::Opcode::kChannelMessage;
+        std::shared_ptr<FileTransfer> transfer = nullptr;
+    };
+
+    /**
+     * Inbound side of one shard: one SPSC queue per source shard, so no two producers
+     * ever share a queue, plus an eventfd the owning loop waits on. Producers push
+     * during an iteration and ring the doorbell once before they block.
+     */
+    class ShardMailbox {
+    public:
+        static constexpr size_t kQueueCapacity = 4096;
+
+        explicit ShardMailbox(int num_shards);
+        ~ShardMailbox();
+
+        bool try_push(int from_shard, const CrossShardMessage& msg) {
+            return queues_[from_shard]->try_push(msg);
+        }
+
+        template <typename Deliver>
+        size_t drain(Deliver&& deliver) {
+            size_t count = 0;
+            for (auto& queue : queues_) {
+                while (auto msg = queue->try_pop()) {
+                    deliver(*msg);
+                    ++count;
+                }
+            }
+            return count;
+        }
+
+        void notify();
+        // Clears the eventfd counter after a wakeup (epoll backend; io_uring reads it).
+        void consume_notification();
+        int event_fd() const { return event_fd_; }
+
+    private:
+        std::vector<std::unique_ptr<SpscQueue<CrossShardMessage>>> queues_;
+        int event_fd_;
+    };
+
+    // Everything the shards share: the control-plane directory, each other's mailboxes,
+    // the channel history budget and read-only access to each other's stats.
+    class ShardGroup {
+    public:
+        ShardGroup(int num_shards, size_t history_budget_bytes);
+
+        int size() const { return static_cast<int>(mailboxes_.size()); }
+        ShardDirectory& directory() { return directory_; }
+        HistoryBudget& history_budget() { return history_budget_; }
+        ShardMailbox& mailbox(int shard) { return *mailboxes_[shard]; }
+        // Wakes every shard, e.g. so each one notices a stop request.
+        void notify_all();
+
+        // Each shard registers its stats before any shard starts running; after that any
+        // thread may render them.
+        void register_stats(int shard, const ServerStats& stats) { stats_[shard] = &stats; }
+        std::string render_metrics() const;
+
+    private:
+        ShardDirectory directory_;
+        HistoryBudget history_budget_;
+        std::vector<std::unique_ptr<ShardMailbox>> mailboxes_;
+        std::vector<const ServerStats*> stats_;
+    };
+
+} // namespace tt::chat::server
+
+#endif // SHARD_GROUP_H
@@ -0,0 +1,91 @@
+#ifndef SHARED_FRAME_H
+#define SHARED_FRAME_H
+
+#include <cassert>
+#include <cstring>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+
+#include "../net/frame-decoder.h"
+#include "../net/protocol.h"
+
+namespace tt::chat::server {
+
+    // A fully encoded frame (v1 length prefix or v2 header, then the body). Built once
+    // per outgoing message and shared, read-only, by every recipient's send; the buffer
+    // is released when the last in-flight send referencing it completes.
+    using SharedFrame = std::shared_ptr<const std::string>;
+
+    /**
+     * Collects a frame body as a list of pieces (e.g. "[", channel, "] ", user, ": ",
+     * text) and writes header and pieces straight into one buffer of the exact final
+     * size, so a message is formatted once, with one copy of each piece, however many
+     * recipients share it. Holds views only: the pieces must outlive every build().
+     */
+    class FrameBuilder {
+    public:
+        static constexpr size_t kMaxPieces = 8;
+
+        FrameBuilder() = default;
+        explicit FrameBuilder(std::string_view body) { append(body); }
+
+        FrameBuilder& append(std::string_view piece) {
+            assert(count_ < kMaxPieces && "FrameBuilder: raise kMaxPieces");
+            pieces_[count_++] = piece;
+            size_ += piece.size();
+            return *this;
+        }
+
+        size_t body_size() const { return size_; }
+        std::span<const std::string_view> pieces() const { return {pieces_, count_}; }
+
+        static size_t header_size(int protocol) {
+            return protocol == net::kProtocolV2 ? net::kV2HeaderSize : net::kLengthPrefixSize;
+        }
+
+        // v1 frames ignore the opcode.
+        SharedFrame build(int protocol, net::Opcode opcode) const {
+            size_t header = header_size(protocol);
+            auto frame = std::make_shared<std::string>(header + size_, '\0');
+            char* out = frame->data();
+            if (protocol == net::kProtocolV2) {
+                net::write_v2_header(out, opcode, size_);
+            } else {
+                net::write_length_prefix(out, size_);
+            }
+            out += header;
+            for (size_t i = 0; i < count_; ++i) {
+                std::memcpy(out, pieces_[i].data(), pieces_[i].size());
+                out += pieces_[i].size();
+            }
+            return frame;
+        }
+
+    private:
+        std::string_view pieces_[kMaxPieces];
+        size_t count_ = 0;
+        size_t size_ = 0;
+    };
+
+    struct FileTransfer;
+
+    /**
+     * One broadcast for a mix of v1 and v2 recipients: built at most once per protocol
+     * version, on first use, and shared by every recipient of that version; v2z is the
+     * v2 frame for members that negotiated compression. The opcode is what v2 recipients
+     * see; frames of a file chunk are counted against its transfer.
+     */
+    struct FanoutFrames {
+        FrameBuilder body;
+        SharedFrame v1;
+        SharedFrame v2;
+        net::Opcode opcode = net::Opcode::kChannelMessage;
+        std::shared_ptr<FileTransfer> transfer = nullptr;
+        SharedFrame v2z = nullptr;
+    };
+
+} // namespace tt::chat::server
+
+#endif // SHARED_FRAME_H
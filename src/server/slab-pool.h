@@ -0,0 +1,69 @@
+#ifndef SLAB_POOL_H
+#define SLAB_POOL_H
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace tt::chat::server {
+
+    /**
+     * Fixed-size object pool for one event-loop thread. Storage comes in slabs of
+     * kSlabObjects slots that are never returned to the heap; freed slots go on an
+     * intrusive free list, so once the pool has grown to the peak number of live objects
+     * create()/destroy() do no heap allocation at all.
+     */
+    template <typename T, size_t kSlabObjects = 256>
+    class SlabPool {
+    public:
+        SlabPool() = default;
+        SlabPool(const SlabPool&) = delete;
+        SlabPool& operator=(const SlabPool&) = delete;
+
+        template <typename... Args>
+        T* create(Args&&... args) {
+            if (!free_list_) {
+                grow();
+            }
+            Slot* slot = free_list_;
+            free_list_ = slot->next;
+            ++in_use_;
+            return new (slot->storage) T(std::forward<Args>(args)...);
+        }
+
+        void destroy(T* object) {
+            object->~T();
+            Slot* slot = reinterpret_cast<Slot*>(object);
+            slot->next = free_list_;
+            free_list_ = slot;
+            --in_use_;
+        }
+
+        size_t in_use() const { return in_use_; }
+        size_t slabs() const { return slabs_.size(); }
+
+    private:
+        union Slot {
+            Slot* next;
+            alignas(T) unsigned char storage[sizeof(T)];
+        };
+
+        void grow() {
+            slabs_.push_back(std::make_unique<Slot[]>(kSlabObjects));
+            Slot* slab = slabs_.back().get();
+            for (size_t i = 0; i < kSlabObjects; ++i) {
+                slab[i].next = free_list_;
+                free_list_ = &slab[i];
+            }
+        }
+
+        std::vector<std::unique_ptr<Slot[]>> slabs_;
+        Slot* free_list_ = nullptr;
+        size_t in_use_ = 0;
+    };
+
+} // namespace tt::chat::server
+
+#endif // SLAB_POOL_H
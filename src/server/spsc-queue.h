@@ -0,0 +1,72 @@
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <optional>
+#include <vector>
+
+namespace tt::chat::server {
+
+    /**
+     * Bounded single-producer/single-consumer ring. Lock-free: the producer only writes
+     * tail_, the consumer only writes head_, and each side keeps a cached copy of the
+     * other's index so the shared cache line is touched only when the cached view says
+     * the ring is full (producer) or empty (consumer).
+     */
+    template <typename T>
+    class SpscQueue {
+    public:
+        // capacity is rounded up to a power of two.
+        explicit SpscQueue(size_t capacity) {
+            size_t size = 1;
+            while (size < capacity) size <<= 1;
+            slots_.resize(size);
+            mask_ = size - 1;
+        }
+
+        SpscQueue(const SpscQueue&) = delete;
+        SpscQueue& operator=(const SpscQueue&) = delete;
+
+        // Producer side. Leaves `value` untouched and returns false when the ring is full.
+        bool try_push(const T& value) {
+            size_t tail = tail_.load(std::memory_order_relaxed);
+            if (tail - cached_head_ > mask_) {
+                cached_head_ = head_.load(std::memory_order_acquire);
+                if (tail - cached_head_ > mask_) {
+                    return false;
+                }
+            }
+            slots_[tail & mask_] = value;
+            tail_.store(tail + 1, std::memory_order_release);
+            return true;
+        }
+
+        // Consumer side.
+        std::optional<T> try_pop() {
+            size_t head = head_.load(std::memory_order_relaxed);
+            if (head == cached_tail_) {
+                cached_tail_ = tail_.load(std::memory_order_acquire);
+                if (head == cached_tail_) {
+                    return std::nullopt;
+                }
+            }
+            std::optional<T> value(std::move(slots_[head & mask_]));
+            slots_[head & mask_] = T{};  // do not keep the moved-from payload alive
+            head_.store(head + 1, std::memory_order_release);
+            return value;
+        }
+
+    private:
+        std::vector<T> slots_;
+        size_t mask_ = 0;
+
+        alignas(64) std::atomic<size_t> head_{0};
+        size_t cached_tail_ = 0;  // consumer's view of tail_
+        alignas(64) std::atomic<size_t> tail_{0};
+        size_t cached_head_ = 0;  // producer's view of head_
+    };
+
+} // namespace tt::chat::server
+
+#endif // SPSC_QUEUE_H
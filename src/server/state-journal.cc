@@ -0,0 +1,106 @@
+#include "state-journal.h"
+#include "message-log.h"
+#include "../utils.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+#include <utility>
+
+namespace tt::chat::server {
+
+StateJournal::StateJournal(std::string dir, std::uint64_t generation)
+    : dir_(std::move(dir)), generation_(generation) {
+  open_file();
+}
+
+StateJournal::~StateJournal() {
+  flush();
+  if (fd_ >= 0) {
+    close(fd_);
+  }
+}
+
+std::string StateJournal::path(const std::string& dir, std::uint64_t generation) {
+  char name[48];
+  snprintf(name, sizeof(name), "journal-%08llu.log", static_cast<unsigned long long>(generation));
+  return dir + "/" + name;
+}
+
+bool StateJournal::parse_name(const std::string& name, std::uint64_t& generation) {
+  constexpr std::string_view kPrefix = "journal-";
+  constexpr std::string_view kSuffix = ".log";
+  if (name.size() <= kPrefix.size() + kSuffix.size() || name.rfind(kPrefix, 0) != 0 ||
+      name.compare(name.size() - kSuffix.size(), kSuffix.size(), kSuffix) != 0) {
+    return false;
+  }
+  std::string digits = name.substr(kPrefix.size(), name.size() - kPrefix.size() - kSuffix.size());
+  if (digits.find_first_not_of("0123456789") != std::string::npos) {
+    return false;
+  }
+  generation = std::stoull(digits);
+  return true;
+}
+
+void StateJournal::open_file() {
+  std::string file = path(dir_, generation_);
+  fd_ = open(file.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0644);
+  check_error(fd_ < 0, "cannot create state journal " + file + ": " + strerror(errno));
+}
+
+void StateJournal::append(StateOp op, std::string_view name) {
+  // Channel names are capped at kMaxChannelNameLength by /create; a truncated name
+  // would come back as a different channel after a restart.
+  assert(name.size() <= 0xffff);
+  auto size = static_cast<std::uint16_t>(name.size());
+  std::string record(kRecordHeaderSize + size, '\0');
+  std::memcpy(record.data() + 4, &size, sizeof(size));
+  record[6] = static_cast<char>(op);
+  std::memcpy(record.data() + kRecordHeaderSize, name.data(), size);
+  std::uint32_t sum = MessageLog::checksum(std::string_view(record).substr(4));
+  std::memcpy(record.data(), &sum, sizeof(sum));
+  records_.fetch_add(1, std::memory_order_relaxed);
+  std::lock_guard<std::mutex> lock(pending_mutex_);
+  pending_ += record;
+}
+
+void StateJournal::flush() {
+  std::lock_guard<std::mutex> lock(write_mutex_);
+  write_pending();
+}
+
+void StateJournal::write_pending() {
+  {
+    std::lock_guard<std::mutex> lock(pending_mutex_);
+    writing_.swap(pending_);
+  }
+  if (writing_.empty()) {
+    return;
+  }
+  size_t done = 0;
+  while (done < writing_.size()) {
+    ssize_t n = write(fd_, writing_.data() + done, writing_.size() - done);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) {
+      // The next snapshot still captures the changes; only a crash before it loses them.
+      errors_.fetch_add(1, std::memory_order_relaxed);
+      SPDLOG_WARN("State journal write failed: {}", n < 0 ? strerror(errno) : "short write");
+      break;
+    }
+    done += n;
+  }
+  writing_.clear();
+}
+
+std::uint64_t StateJournal::rotate() {
+  std::lock_guard<std::mutex> lock(write_mutex_);
+  write_pending();
+  close(fd_);
+  ++generation_;
+  open_file();
+  return generation_;
+}
+
+} // namespace tt::chat::server
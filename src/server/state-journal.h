@@ -0,0 +1,77 @@
+#ifndef STATE_JOURNAL_H
+#define STATE_JOURNAL_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+namespace tt::chat::server {
+
+    // Directory changes worth keeping across a restart.
+    enum class StateOp : std::uint8_t {
+        kCreateChannel = 1,
+    };
+
+    /**
+     * Append-only record of the directory changes made since the last snapshot, one file
+     * per generation, named journal-<generation>.log. Each record is
+     *
+     *   u32 FNV-1a of the rest | u16 name length | u8 op | u8 0 | name
+     *
+     * in host byte order. Records are written with no fsync: they survive the process
+     * restarting or crashing, which is what this is for, while the snapshot is synced.
+     *
+     * The owning ShardDirectory appends under its own lock, which orders appends
+     * against rotate(). append() only queues the encoded record; the write() happens in
+     * flush(), which the caller runs after releasing that lock, so no other shard's
+     * directory call waits on the disk. rotate() writes whatever is still queued to
+     * the generation it belongs to first.
+     */
+    class StateJournal {
+    public:
+        static constexpr size_t kRecordHeaderSize = 8;
+
+        // Creates the journal for `generation`; any file of that name is replaced.
+        StateJournal(std::string dir, std::uint64_t generation);
+        ~StateJournal();
+
+        StateJournal(const StateJournal&) = delete;
+        StateJournal& operator=(const StateJournal&) = delete;
+
+        void append(StateOp op, std::string_view name);
+        // Writes the queued records, in append order. Safe from any thread.
+        void flush();
+        // Closes this generation's file and starts the next. Returns the new generation.
+        std::uint64_t rotate();
+
+        std::uint64_t generation() const { return generation_; }
+        // Records appended over all generations; readable from any thread.
+        std::uint64_t records() const { return records_.load(std::memory_order_relaxed); }
+        std::uint64_t errors() const { return errors_.load(std::memory_order_relaxed); }
+
+        static std::string path(const std::string& dir, std::uint64_t generation);
+        // Reads the generation out of a journal file name; false for any other name.
+        static bool parse_name(const std::string& name, std::uint64_t& generation);
+
+    private:
+        void open_file();
+        void write_pending();  // with write_mutex_ held
+
+        std::string dir_;
+        std::uint64_t generation_;
+        int fd_ = -1;
+        std::atomic<std::uint64_t> records_{0};
+        std::atomic<std::uint64_t> errors_{0};
+
+        std::mutex write_mutex_;    // fd_ and the write order; taken before pending_mutex_
+        std::mutex pending_mutex_;  // pending_ only, held just to append or swap
+        std::string pending_;
+        std::string writing_;       // the batch being written, kept for its capacity
+    };
+
+} // namespace tt::chat::server
+
+#endif // STATE_JOURNAL_H
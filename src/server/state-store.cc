@@ -0,0 +1,304 @@
+#include "state-store.h"
+#include "message-log.h"
+#include "../utils.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace tt::chat::server {
+
+namespace {
+
+constexpr char kSnapshotMagic[8] = {'T', 'T', 'C', 'H', 'S', 'N', 'A', 'P'};
+constexpr std::uint32_t kSnapshotVersion = 2;  // 1 also held usernames
+constexpr const char* kSnapshotFile = "state.snap";
+
+struct SnapshotHeader {
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t channel_count;
+  std::uint32_t checksum;  // FNV-1a of everything after the header
+  std::uint32_t reserved;  // 0, keeps the u64s below aligned
+  std::uint64_t journal_generation;
+  std::uint64_t strings_size;
+};
+
+struct SnapshotChannel {
+  std::uint32_t id;
+  std::uint32_t name_offset;
+  std::uint32_t name_size;
+};
+
+static_assert(std::is_trivially_copyable_v<SnapshotHeader> && sizeof(SnapshotHeader) == 40);
+static_assert(sizeof(SnapshotChannel) == 12);
+
+// Read-only private mapping of a whole file, unmapped on scope exit.
+class MappedFile {
+public:
+  explicit MappedFile(const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    check_error(fd < 0, "cannot open " + path + ": " + strerror(errno));
+    struct stat st{};
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+      size_ = static_cast<size_t>(st.st_size);
+      void* data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+      data_ = data == MAP_FAILED ? nullptr : static_cast<const char*>(data);
+    }
+    close(fd);
+    check_error(data_ == nullptr && size_ > 0, "cannot map " + path + ": " + strerror(errno));
+  }
+  ~MappedFile() {
+    if (data_) {
+      munmap(const_cast<char*>(data_), size_);
+    }
+  }
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  const char* data() const { return data_; }
+  size_t size() const { return size_; }
+
+private:
+  const char* data_ = nullptr;
+  size_t size_ = 0;
+};
+
+template <typename T>
+void append_raw(std::string& out, const T& value) {
+  out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+bool write_file_synced(const std::string& path, const std::string& data) {
+  int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    return false;
+  }
+  size_t done = 0;
+  while (done < data.size()) {
+    ssize_t n = write(fd, data.data() + done, data.size() - done);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) break;
+    done += n;
+  }
+  bool ok = done == data.size() && fdatasync(fd) == 0;
+  close(fd);
+  return ok;
+}
+
+void sync_directory(const std::string& dir) {
+  int fd = open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (fd >= 0) {
+    fsync(fd);
+    close(fd);
+  }
+}
+
+std::vector<std::uint64_t> journal_generations(const std::string& dir) {
+  std::vector<std::uint64_t> generations;
+  for (const auto& entry : std::filesystem::directory_iterator(dir)) {
+    std::uint64_t generation;
+    if (StateJournal::parse_name(entry.path().filename().string(), generation)) {
+      generations.push_back(generation);
+    }
+  }
+  std::sort(generations.begin(), generations.end());
+  return generations;
+}
+
+double ms_since(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+} // namespace
+
+StateStore::StateStore(std::string dir, ShardDirectory& directory)
+    : dir_(std::move(dir)), directory_(directory) {
+  std::error_code ec;
+  std::filesystem::create_directories(dir_, ec);
+  check_error(static_cast<bool>(ec), "cannot create state directory " + dir_ + ": " + ec.message());
+}
+
+StateStore::~StateStore() {
+  stop();
+  if (journal_) {
+    directory_.set_journal(nullptr);
+  }
+}
+
+StateStore::RestoreStats StateStore::restore() {
+  auto start = std::chrono::steady_clock::now();
+  RestoreStats stats;
+  std::uint64_t first_generation = 0;
+  std::string snapshot_path = dir_ + "/" + kSnapshotFile;
+  if (std::filesystem::exists(snapshot_path)) {
+    first_generation = load_snapshot(snapshot_path);
+  }
+  std::uint64_t next_generation = std::max<std::uint64_t>(first_generation, 1);
+  for (std::uint64_t generation : journal_generations(dir_)) {
+    std::string path = StateJournal::path(dir_, generation);
+    if (generation < first_generation) {
+      unlink(path.c_str());  // left over from a snapshot that was cut short
+      continue;
+    }
+    stats.journal_records += replay_journal(path);
+    next_generation = generation + 1;
+  }
+  // Always a fresh file: whatever tail a crash tore off the last one stays behind it.
+  journal_ = std::make_unique<StateJournal>(dir_, next_generation);
+  directory_.set_journal(journal_.get());
+  stats.channels = directory_.channel_count();
+  stats.ms = ms_since(start);
+  SPDLOG_INFO("State restored from {}: channels={} journal_records={} in {:.1f} ms",
+              dir_, stats.channels, stats.journal_records, stats.ms);
+  return stats;
+}
+
+std::uint64_t StateStore::load_snapshot(const std::string& path) {
+  MappedFile file(path);
+  SnapshotHeader header{};
+  check_error(file.size() < sizeof(header), "state snapshot " + path + " is truncated");
+  std::memcpy(&header, file.data(), sizeof(header));
+  check_error(std::memcmp(header.magic, kSnapshotMagic, sizeof(kSnapshotMagic)) != 0 ||
+                  header.version != kSnapshotVersion,
+              "state snapshot " + path + " has an unknown format");
+  size_t channels_size = size_t{header.channel_count} * sizeof(SnapshotChannel);
+  check_error(file.size() != sizeof(header) + channels_size + header.strings_size,
+              "state snapshot " + path + " has the wrong size");
+  std::string_view body(file.data() + sizeof(header), file.size() - sizeof(header));
+  check_error(MessageLog::checksum(body) != header.checksum,
+              "state snapshot " + path + " fails its checksum");
+
+  // The entry arrays sit at 4-byte-aligned offsets of a page-aligned mapping.
+  const auto* channels = reinterpret_cast<const SnapshotChannel*>(body.data());
+  std::string_view strings = body.substr(channels_size);
+  auto string_at = [&](std::uint32_t offset, std::uint32_t size) {
+    check_error(size_t{offset} + size > strings.size(), "state snapshot " + path + " is corrupt");
+    return strings.substr(offset, size);
+  };
+  for (std::uint32_t i = 0; i < header.channel_count; ++i) {
+    // Ids are dense and written in order, so handing them out again in order
+    // reproduces them; anything else means the file is not what we wrote.
+    ChannelEntry* entry = directory_.restore_channel(string_at(channels[i].name_offset, channels[i].name_size));
+    check_error(!entry || entry->id != channels[i].id, "state snapshot " + path + " is corrupt");
+  }
+  return header.journal_generation;
+}
+
+size_t StateStore::replay_journal(const std::string& path) {
+  MappedFile file(path);
+  std::string_view data(file.data(), file.size());
+  size_t records = 0;
+  size_t pos = 0;
+  while (pos + StateJournal::kRecordHeaderSize <= data.size()) {
+    std::uint32_t sum;
+    std::uint16_t size;
+    std::memcpy(&sum, data.data() + pos, sizeof(sum));
+    std::memcpy(&size, data.data() + pos + 4, sizeof(size));
+    auto op = static_cast<StateOp>(data[pos + 6]);
+    size_t end = pos + StateJournal::kRecordHeaderSize + size;
+    if (end > data.size() || MessageLog::checksum(data.substr(pos + 4, end - pos - 4)) != sum) {
+      break;
+    }
+    std::string_view name = data.substr(pos + StateJournal::kRecordHeaderSize, size);
+    if (op == StateOp::kCreateChannel) {
+      directory_.restore_channel(name);
+    }
+    ++records;
+    pos = end;
+  }
+  if (pos != data.size()) {
+    // Only the last record of a journal can be torn, by a crash mid-write.
+    SPDLOG_WARN("Ignoring {} damaged bytes at the end of {}", data.size() - pos, path);
+  }
+  return records;
+}
+
+void StateStore::snapshot() {
+  auto start = std::chrono::steady_clock::now();
+  if (journal_) {
+    snapshot_records_ = journal_->records();
+  }
+  DirectoryState state = directory_.capture_state();
+
+  std::string strings;
+  std::vector<SnapshotChannel> channels;
+  channels.reserve(state.channels.size());
+  for (const ChannelEntry* entry : state.channels) {
+    channels.push_back({entry->id, static_cast<std::uint32_t>(strings.size()),
+                        static_cast<std::uint32_t>(entry->name.size())});
+    strings += entry->name;
+  }
+
+  SnapshotHeader header{};
+  std::memcpy(header.magic, kSnapshotMagic, sizeof(kSnapshotMagic));
+  header.version = kSnapshotVersion;
+  header.channel_count = static_cast<std::uint32_t>(channels.size());
+  header.journal_generation = state.journal_generation;
+  header.strings_size = strings.size();
+  std::string file;
+  file.reserve(sizeof(header) + channels.size() * sizeof(SnapshotChannel) + strings.size());
+  append_raw(file, header);
+  for (const auto& channel : channels) append_raw(file, channel);
+  file += strings;
+  header.checksum = MessageLog::checksum(std::string_view(file).substr(sizeof(header)));
+  std::memcpy(file.data(), &header, sizeof(header));
+
+  std::string path = dir_ + "/" + kSnapshotFile;
+  std::string tmp_path = path + ".tmp";
+  if (!write_file_synced(tmp_path, file) || rename(tmp_path.c_str(), path.c_str()) != 0) {
+    // The previous snapshot and every journal since it are still in place.
+    SPDLOG_ERROR("State snapshot to {} failed: {}", path, strerror(errno));
+    unlink(tmp_path.c_str());
+    return;
+  }
+  sync_directory(dir_);
+  for (std::uint64_t generation : journal_generations(dir_)) {
+    if (generation < state.journal_generation) {
+      unlink(StateJournal::path(dir_, generation).c_str());
+    }
+  }
+  SPDLOG_INFO("State snapshot: channels={} bytes={} in {:.1f} ms",
+              channels.size(), file.size(), ms_since(start));
+}
+
+void StateStore::start(int interval_s) {
+  if (interval_s <= 0) {
+    return;
+  }
+  thread_ = std::thread([this, interval_s] { run_periodic(std::chrono::seconds(interval_s)); });
+}
+
+void StateStore::stop() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  wake_.notify_all();
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+}
+
+void StateStore::run_periodic(std::chrono::seconds interval) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!wake_.wait_for(lock, interval, [this] { return stopping_; })) {
+    lock.unlock();
+    // An idle directory keeps the snapshot it has.
+    if (!journal_ || journal_->records() != snapshot_records_) {
+      snapshot();
+    }
+    lock.lock();
+  }
+}
+
+} // namespace tt::chat::server
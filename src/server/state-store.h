@@ -0,0 +1,78 @@
+#ifndef STATE_STORE_H
+#define STATE_STORE_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "shard-directory.h"
+#include "state-journal.h"
+
+namespace tt::chat::server {
+
+    /**
+     * Keeps the directory's channels across restarts, as a snapshot file
+     * (state.snap) plus the journal of changes made after it (state-journal.h).
+     * restore() loads the snapshot and replays only the journal tail; snapshot() writes
+     * a fresh one and deletes the journals it covers.
+     *
+     * state.snap is laid out to be read in place from mmap, with no parsing pass:
+     *
+     *   header (kSnapshotMagic, version, counts, journal generation, checksum)
+     *   channel entries: u32 id | u32 name offset | u32 name length, in id order
+     *   string bytes, which the entries point into
+     *
+     * All integers are in host byte order. A snapshot is written to a temporary file,
+     * synced and renamed over the old one, so state.snap is always whole.
+     */
+    class StateStore {
+    public:
+        struct RestoreStats {
+            size_t channels = 0;
+            size_t journal_records = 0;
+            double ms = 0;
+        };
+
+        StateStore(std::string dir, ShardDirectory& directory);
+        ~StateStore();
+
+        StateStore(const StateStore&) = delete;
+        StateStore& operator=(const StateStore&) = delete;
+
+        // Call once, before any shard starts: fills the directory, then journals every
+        // later change into a new generation.
+        // @throws std::runtime_error if the snapshot is damaged.
+        RestoreStats restore();
+        // Writes a snapshot now. Safe while the shards run; not concurrently with itself.
+        void snapshot();
+
+        // Snapshots every interval_s on a background thread (0 = no periodic snapshots).
+        void start(int interval_s);
+        // Stops the thread; the caller takes the final snapshot.
+        void stop();
+
+    private:
+        // Returns the first journal generation the snapshot does not cover.
+        std::uint64_t load_snapshot(const std::string& path);
+        size_t replay_journal(const std::string& path);
+        void run_periodic(std::chrono::seconds interval);
+
+        std::string dir_;
+        ShardDirectory& directory_;
+        std::unique_ptr<StateJournal> journal_;
+        std::uint64_t snapshot_records_ = 0;  // journal_->records() at the last snapshot
+
+        std::mutex mutex_;
+        std::condition_variable wake_;
+        bool stopping_ = false;
+        std::thread thread_;
+    };
+
+} // namespace tt::chat::server
+
+#endif // STATE_STORE_H
@@ -3,99 +3,387 @@
 #include "../net/chat-sockets.h"
 
 #include "channel_manager.h"
+#include "alloc-stats.h"
+#include "hot-log.h"
 
 #include <spdlog/spdlog.h>
 #include <fstream>
+#include <cerrno>
+#include <utility>
 
 namespace tt::chat::server {
 
 #ifdef IO_URING_ENABLED
-void EpollServer::setup_io_uring() {
+void EpollServer::init_ring() {
+  if (config_.sqpoll) {
+    io_uring_params params{};
+    params.flags = IORING_SETUP_SQPOLL;
+    params.sq_thread_idle = config_.sqpoll_idle_ms;
+    if (config_.sqpoll_cpu >= 0) {
+      params.flags |= IORING_SETUP_SQ_AFF;
+      params.sq_thread_cpu = config_.sqpoll_cpu + shard_id_;
+    }
+    int ret = io_uring_queue_init_params(QUEUE_DEPTH, &ring_, &params);
+    if (ret == 0) {
+      SPDLOG_INFO("SQPOLL enabled (idle {} ms, cpu {})", config_.sqpoll_idle_ms,
+                  config_.sqpoll_cpu >= 0 ? std::to_string(config_.sqpoll_cpu + shard_id_) : "any");
+      return;
+    }
+    // Older kernels need CAP_SYS_NICE for SQPOLL
+    SPDLOG_WARN("SQPOLL unavailable ({}), using a regular ring", strerror(-ret));
+  }
   int ret = io_uring_queue_init(QUEUE_DEPTH, &ring_, 0);
   check_error(ret < 0, "io_uring_queue_init failed");
 }
 
+void EpollServer::setup_io_uring() {
+  init_ring();
+  multishot_ = config_.multishot && setup_buf_ring();
+
+  if (config_.fixed_files) {
+    int ret = io_uring_register_files_sparse(&ring_, kFixedFileSlots);
+    if (ret < 0) {
+      SPDLOG_WARN("Fixed-file table unavailable ({}), using plain fds", strerror(-ret));
+    } else {
+      fixed_files_ = true;
+    }
+  }
+
+  zero_copy_send_ = config_.zc_threshold > 0 && probe_send_zc();
+}
+
+bool EpollServer::probe_send_zc() {
+  io_uring_probe* probe = io_uring_get_probe_ring(&ring_);
+  if (!probe) {
+    SPDLOG_WARN("io_uring probe unavailable, zero-copy send disabled");
+    return false;
+  }
+  bool supported = io_uring_opcode_supported(probe, IORING_OP_SEND_ZC);
+  io_uring_free_probe(probe);
+  if (!supported) {
+    SPDLOG_WARN("Kernel lacks IORING_OP_SEND_ZC, zero-copy send disabled");
+  }
+  return supported;
+}
+
+io_uring_sqe* EpollServer::get_sqe() {
+  io_uring_sqe* sqe = io_uring_get_sqe(&ring_);
+  if (!sqe) {
+    // SQ full: hand what is queued to the kernel and retry rather than dropping the op
+    stats_.sq_full_flushes++;
+    if (flush_submissions() >= 0) {
+      sqe = io_uring_get_sqe(&ring_);
+    }
+  }
+  return sqe;
+}
+
+int EpollServer::flush_submissions() {
+  int ret = io_uring_submit(&ring_);
+  if (ret < 0) {
+    SPDLOG_ERROR("io_uring_submit failed: {}", strerror(-ret));
+    return ret;
+  }
+  stats_.submit_calls++;
+  stats_.syscalls++;
+  stats_.sqes_submitted += ret;
+  return ret;
+}
+
+void EpollServer::wait_and_process_events() {
+  commit_message_log();
+  // One send per client for everything queued to it while handling the last batch.
+  flush_due_clients();
+  ring_doorbells();
+  if (spin_.enabled() && spin_for_completions()) {
+    stats_.loop_iterations++;
+    handle_io_uring_events();
+    return;
+  }
+  // The only submit of a normal iteration: everything queued while handling the previous
+  // CQE batch goes to the kernel together with the wait for the next one. Output held
+  // for coalescing bounds the wait.
+  std::int64_t wait_ns = flush_wait_ns();
+  int ret;
+  if (wait_ns < 0) {
+    ret = io_uring_submit_and_wait(&ring_, 1);
+  } else {
+    __kernel_timespec timeout{wait_ns / 1000000000, wait_ns % 1000000000};
+    io_uring_cqe* cqe;
+    ret = io_uring_submit_and_wait_timeout(&ring_, &cqe, 1, &timeout, nullptr);
+    if (ret == -ETIME) ret = 0;
+  }
+  if (ret < 0) {
+    check_error(ret != -EINTR, "io_uring_submit_and_wait failed");
+    return;
+  }
+  stats_.loop_iterations++;
+  stats_.submit_calls++;
+  stats_.syscalls++;
+  stats_.sqes_submitted += ret;
+  handle_io_uring_events();
+}
+
+bool EpollServer::spin_for_completions() {
+  // Hand the queued SQEs over without waiting (with SQPOLL this usually needs no syscall),
+  // then watch the CQ ring, which the kernel fills without us entering it.
+  if (io_uring_sq_ready(&ring_) > 0 && flush_submissions() < 0) {
+    return false;
+  }
+  io_uring_cqe* cqe;
+  return spin_.spin([&] { return io_uring_peek_cqe(&ring_, &cqe) == 0; });
+}
+
+void EpollServer::mark_client_sqe(io_uring_sqe* sqe) const {
+  if (fixed_files_) {
+    sqe->flags |= IOSQE_FIXED_FILE;
+  }
+}
+
+void EpollServer::cancel_request(IoUringContext* ctx) {
+  auto* sqe = get_sqe();
+  if (!sqe) {
+    SPDLOG_ERROR("Failed to get SQE for cancel");
+    return;
+  }
+  io_uring_prep_cancel(sqe, ctx, 0);
+  io_uring_sqe_set_data(sqe, nullptr);
+}
+
+void EpollServer::close_client_file(int client_fd) {
+  if (!fixed_files_) {
+    // Queued SQEs resolve the fd number only when submitted; hand them over first so a
+    // new connection that reuses the number cannot receive them.
+    if (io_uring_sq_ready(&ring_) > 0) {
+      flush_submissions();
+    }
+    close(client_fd);
+    return;
+  }
+  auto* sqe = get_sqe();
+  if (!sqe) {
+    SPDLOG_ERROR("Failed to get SQE for closing fixed slot {}", client_fd);
+    return;
+  }
+  io_uring_prep_close_direct(sqe, client_fd);
+  io_uring_sqe_set_data(sqe, nullptr);
+}
+
+bool EpollServer::setup_buf_ring() {
+  int ret = 0;
+  buf_ring_ = io_uring_setup_buf_ring(&ring_, kBufRingEntries, kBufGroupId, 0, &ret);
+  if (!buf_ring_) {
+    SPDLOG_WARN("Provided-buffer ring unavailable ({}), using single-shot recv", strerror(-ret));
+    return false;
+  }
+  buf_ring_slab_ = std::make_unique<char[]>(size_t{kBufRingEntries} * kBufRingBufSize);
+  int mask = io_uring_buf_ring_mask(kBufRingEntries);
+  for (unsigned bid = 0; bid < kBufRingEntries; ++bid) {
+    io_uring_buf_ring_add(buf_ring_, buf_ring_slab_.get() + size_t{bid} * kBufRingBufSize,
+                          kBufRingBufSize, bid, mask, bid);
+  }
+  io_uring_buf_ring_advance(buf_ring_, kBufRingEntries);
+  return true;
+}
+
+void EpollServer::recycle_buffer(unsigned buffer_id) {
+  io_uring_buf_ring_add(buf_ring_, buf_ring_slab_.get() + size_t{buffer_id} * kBufRingBufSize,
+                        kBufRingBufSize, buffer_id, io_uring_buf_ring_mask(kBufRingEntries), 0);
+  io_uring_buf_ring_advance(buf_ring_, 1);
+}
+
 void EpollServer::submit_accept() {
-  auto* sqe = io_uring_get_sqe(&ring_);
+  if (multishot_) {
+    submit_multishot_accept(new_context(IO_ACCEPT_MULTISHOT, listen_sock_));
+    return;
+  }
+  auto* sqe = get_sqe();
   if (!sqe) {
     SPDLOG_ERROR("Failed to get SQE for accept");
     return;
   }
-  auto* ctx = new IoUringContext{IO_ACCEPT, 0, nullptr, 0, new sockaddr_in(), new socklen_t(sizeof(sockaddr_in))};
-  io_uring_prep_accept(sqe, listen_sock_, (sockaddr*)ctx->client_addr, ctx->addr_len, 0);
+  auto* ctx = new_context(IO_ACCEPT, 0);
+  if (fixed_files_) {
+    io_uring_prep_accept_direct(sqe, listen_sock_, (sockaddr*)&ctx->client_addr, &ctx->addr_len, 0,
+                                IORING_FILE_INDEX_ALLOC);
+  } else {
+    io_uring_prep_accept(sqe, listen_sock_, (sockaddr*)&ctx->client_addr, &ctx->addr_len, 0);
+  }
   io_uring_sqe_set_data(sqe, ctx);
-  io_uring_submit(&ring_);
 }
 
-void EpollServer::submit_recv_length(int client_fd) {
-  auto* sqe = io_uring_get_sqe(&ring_);
+void EpollServer::submit_multishot_accept(IoUringContext* ctx) {
+  auto* sqe = get_sqe();
   if (!sqe) {
-    SPDLOG_ERROR("Failed to get SQE for recv length");
+    SPDLOG_ERROR("Failed to get SQE for multishot accept");
+    release_context(ctx);
     return;
   }
-  
-  // Allocate buffer for 20-byte length prefix
-  auto* ctx = new IoUringContext{IO_RECV_LENGTH, client_fd, new char[20], 20, nullptr, nullptr};
-  io_uring_prep_recv(sqe, client_fd, ctx->buffer, 20, 0);
+  if (fixed_files_) {
+    // CQE result is the allocated slot in the fixed-file table, never a process fd
+    io_uring_prep_multishot_accept_direct(sqe, listen_sock_, nullptr, nullptr, 0);
+  } else {
+    io_uring_prep_multishot_accept(sqe, listen_sock_, nullptr, nullptr, 0);
+  }
   io_uring_sqe_set_data(sqe, ctx);
-  io_uring_submit(&ring_);
 }
 
-void EpollServer::submit_recv_message(int client_fd, int message_length) {
-  auto* sqe = io_uring_get_sqe(&ring_);
+void EpollServer::submit_multishot_recv(IoUringContext* ctx) {
+  auto* sqe = get_sqe();
   if (!sqe) {
-    SPDLOG_ERROR("Failed to get SQE for recv message");
+    SPDLOG_ERROR("Failed to get SQE for multishot recv");
+    release_context(ctx);
     return;
   }
-  
-  // Allocate buffer for actual message
-  auto* ctx = new IoUringContext{IO_RECV_MESSAGE, client_fd, new char[message_length], message_length, nullptr, nullptr};
-  io_uring_prep_recv(sqe, client_fd, ctx->buffer, message_length, 0);
+  // No buffer here: the kernel picks one from the ring for each completion, so an idle
+  // connection pins no memory.
+  io_uring_prep_recv_multishot(sqe, ctx->client_fd, nullptr, 0, 0);
+  mark_client_sqe(sqe);
+  sqe->flags |= IOSQE_BUFFER_SELECT;
+  sqe->buf_group = kBufGroupId;
   io_uring_sqe_set_data(sqe, ctx);
-  io_uring_submit(&ring_);
 }
 
-void EpollServer::submit_send(int client_fd, const std::string& message) {
-  // First, send the length prefix
-  std::string msg_sz_str = std::to_string(message.size());
-  if (msg_sz_str.length() > 20) {
-    SPDLOG_ERROR("Message size ({}) exceeds 20-character length prefix limit for client {}",
-                 message.size(), client_fd);
-    msg_sz_str = msg_sz_str.substr(msg_sz_str.length() - 20);
+void EpollServer::start_client_recv(int client_fd) {
+  if (multishot_) {
+    submit_multishot_recv(new_context(IO_RECV_MULTISHOT, client_fd));
+  } else {
+    // The context and its buffer are reused for every re-arm until the client goes away.
+    submit_recv(new_recv_context(client_fd));
   }
-  msg_sz_str = std::string(20 - msg_sz_str.length(), '0') + msg_sz_str;
-  
-  // Submit length prefix send
-  auto* sqe_len = io_uring_get_sqe(&ring_);
-  if (!sqe_len) {
-    SPDLOG_ERROR("Failed to get SQE for send length");
+}
+
+void EpollServer::submit_recv(IoUringContext* ctx) {
+  auto* sqe = get_sqe();
+  if (!sqe) {
+    SPDLOG_ERROR("Failed to get SQE for recv");
+    release_context(ctx);
     return;
   }
   
-  auto* len_buffer = new char[20];
-  memcpy(len_buffer, msg_sz_str.c_str(), 20);
-  
-  auto* ctx_len = new IoUringContext{IO_SEND_LENGTH, client_fd, len_buffer, 20, nullptr, nullptr};
-  io_uring_prep_send(sqe_len, client_fd, len_buffer, 20, 0);
-  io_uring_sqe_set_data(sqe_len, ctx_len);
+  // Ask for as much as fits: the decoder copes with any split of frames across reads
+  io_uring_prep_recv(sqe, ctx->client_fd, ctx->buffer, ctx->buffer_size, 0);
+  mark_client_sqe(sqe);
+  io_uring_sqe_set_data(sqe, ctx);
+}
+
+bool EpollServer::submit_send(int client_fd, const SharedFrame& frame, size_t offset, std::uint64_t conn_id) {
+  auto* sqe = get_sqe();
+  if (!sqe) {
+    SPDLOG_ERROR("Failed to get SQE for send");
+    return false;
+  }
   
-  // Submit message send
-  auto* sqe_msg = io_uring_get_sqe(&ring_);
-  if (!sqe_msg) {
-    SPDLOG_ERROR("Failed to get SQE for send message");
-    delete[] len_buffer;
-    delete ctx_len;
+  // No copy: the SQE points into the shared frame, which the context keeps alive. Large
+  // frames also skip the copy into socket buffers; the kernel then pins the pages until
+  // it posts a notification CQE, so the context outlives the send result.
+  size_t len = frame->size() - offset;
+  bool zero_copy = zero_copy_send_ && len >= static_cast<size_t>(config_.zc_threshold);
+  auto* ctx = new_context(zero_copy ? IO_SEND_ZC : IO_SEND, client_fd);
+  ctx->buffer = const_cast<char*>(frame->data()) + offset;
+  ctx->buffer_size = len;
+  ctx->frame = frame;
+  ctx->conn_id = conn_id;
+  stats_.send_calls++;
+  stats_.frames_per_send.record(1);
+  if (zero_copy) {
+    stats_.zc_sends++;
+    io_uring_prep_send_zc(sqe, client_fd, ctx->buffer, len, MSG_NOSIGNAL, 0);
+  } else {
+    io_uring_prep_send(sqe, client_fd, ctx->buffer, len, MSG_NOSIGNAL);
+  }
+  mark_client_sqe(sqe);
+  io_uring_sqe_set_data(sqe, ctx);
+  return true;
+}
+
+size_t EpollServer::submit_sendmsg(int client_fd, const Connection& conn) {
+  auto* sqe = get_sqe();
+  if (!sqe) {
+    SPDLOG_ERROR("Failed to get SQE for sendmsg");
+    return 0;
+  }
+  // The batch holds its own frame references: a drop or a teardown may empty the queue
+  // while the kernel still reads from them.
+  SendBatch* batch = send_batch_pool_.create();
+  size_t bytes = 0;
+  size_t count = conn.out.gather(batch->iov, OutboundQueue::kMaxGather, bytes);
+  for (size_t i = 0; i < count; ++i) {
+    batch->frames[i] = conn.out.at(i);
+  }
+  batch->msg.msg_iov = batch->iov;
+  batch->msg.msg_iovlen = count;
+  auto* ctx = new_context(IO_SENDMSG, client_fd);
+  ctx->batch = batch;
+  ctx->buffer_size = bytes;
+  ctx->conn_id = conn.conn_id;
+  stats_.send_calls++;
+  stats_.frames_per_send.record(count);
+  io_uring_prep_sendmsg(sqe, client_fd, &batch->msg, MSG_NOSIGNAL);
+  mark_client_sqe(sqe);
+  io_uring_sqe_set_data(sqe, ctx);
+  return count;
+}
+
+void EpollServer::on_send_result(IoUringContext* ctx, int result) {
+  Connection* conn = connections_.find(ctx->client_fd);
+  if (!conn || conn->conn_id != ctx->conn_id || conn->closing) {
+    return; // Connection gone (the fd may already belong to someone else) or being torn down
+  }
+  conn->out.set_in_flight(0);
+  if (result < 0) {
+    // Teardown is left to the recv side, which sees the same error or EOF. Disconnecting
+    // here could close a slot/fd that has already been reused by a new client.
+    SPDLOG_ERROR("Send failed for client {}: {}", ctx->client_fd, strerror(-result));
+    fail_outbound(ctx->client_fd, *conn);
     return;
   }
-  
-  auto* msg_buffer = new char[message.size()];
-  memcpy(msg_buffer, message.c_str(), message.size());
-  
-  auto* ctx_msg = new IoUringContext{IO_SEND_MESSAGE, client_fd, msg_buffer, message.size(), nullptr, nullptr};
-  io_uring_prep_send(sqe_msg, client_fd, msg_buffer, message.size(), 0);
-  io_uring_sqe_set_data(sqe_msg, ctx_msg);
-  
-  io_uring_submit(&ring_);
+  // A short send leaves the rest of the frame at the front of the queue; the next
+  // submit resumes from the new offset.
+  account_written(*conn, result, ctx->buffer_size);
+  flush_outbound(ctx->client_fd, *conn);
+}
+
+void EpollServer::continue_recv(IoUringContext* ctx) {
+  Connection* conn = connections_.find(ctx->client_fd);
+  if (conn && conn->read_pauses > 0 && !conn->closing) {
+    conn->parked_recv = ctx; // resume_reads() re-arms it
+    return;
+  }
+  if (ctx->op_type == IO_RECV_MULTISHOT) {
+    submit_multishot_recv(ctx);
+  } else {
+    submit_recv(ctx);
+  }
+}
+
+void EpollServer::submit_wakeup_read(IoUringContext* ctx) {
+  auto* sqe = get_sqe();
+  if (!sqe) {
+    SPDLOG_ERROR("Failed to get SQE for mailbox wakeup");
+    return;
+  }
+  // Plain fd even with fixed files: the eventfd is not in the ring's file table.
+  io_uring_prep_read(sqe, ctx->client_fd, ctx->buffer, ctx->buffer_size, 0);
+  io_uring_sqe_set_data(sqe, ctx);
+}
+
+IoUringContext* EpollServer::new_context(IoOpType type, int fd) {
+  return ctx_pool_.create(type, fd);
+}
+
+IoUringContext* EpollServer::new_recv_context(int client_fd) {
+  return ctx_pool_.create(IO_RECV, client_fd, recv_buffer_pool_.create()->data, kBufRingBufSize);
+}
+
+void EpollServer::release_context(IoUringContext* ctx) {
+  if (ctx->op_type == IO_RECV && ctx->buffer) {
+    recv_buffer_pool_.destroy(reinterpret_cast<RecvBuffer*>(ctx->buffer));
+  }
+  if (ctx->batch) {
+    send_batch_pool_.destroy(ctx->batch);
+  }
+  ctx_pool_.destroy(ctx);
 }
 
 void EpollServer::handle_io_uring_events() {
@@ -111,143 +399,203 @@ void EpollServer::handle_io_uring_events() {
         case IO_ACCEPT: 
           handle_accept_completion(cqe->res, ctx); 
           break;
-        case IO_RECV_LENGTH:   
-          handle_recv_length_completion(cqe->res, ctx); 
-          break;
-        case IO_RECV_MESSAGE:   
-          handle_recv_message_completion(cqe->res, ctx); 
+        case IO_RECV:   
+          handle_recv_completion(cqe->res, ctx); 
           break;
-        case IO_SEND_LENGTH:   
-        case IO_SEND_MESSAGE:   
+        case IO_SEND:   
+        case IO_SENDMSG:
           handle_send_completion(cqe->res, ctx); 
           break;
+        case IO_SEND_ZC:
+          handle_send_zc_completion(cqe->res, cqe->flags, ctx);
+          break;
+        case IO_ACCEPT_MULTISHOT:
+          handle_multishot_accept_completion(cqe->res, cqe->flags, ctx);
+          break;
+        case IO_RECV_MULTISHOT:
+          handle_multishot_recv_completion(cqe->res, cqe->flags, ctx);
+          break;
+        case IO_WAKEUP:
+          drain_mailbox();
+          submit_wakeup_read(ctx);
+          break;
+        case IO_LOG_WRITE:
+        case IO_LOG_FSYNC:
+          handle_log_completion(cqe->res, ctx);
+          break;
       }
     }
     count++;
   }
   
   io_uring_cq_advance(&ring_, count);
+  stats_.completions_per_loop.record(count);
 }
 
 void EpollServer::handle_accept_completion(int result, IoUringContext* ctx) {
   if (result < 0) {
     SPDLOG_ERROR("Accept failed: {}", strerror(-result));
   } else {
-    client_usernames_[result] = "user_" + std::to_string(result);
-    SPDLOG_INFO("New connection: {}", client_usernames_[result]);
-    submit_recv_length(result); // Start by reading length prefix
+    on_client_accepted(result);
   }
   
   submit_accept(); // Continue accepting
-  delete ctx->client_addr;
-  delete ctx->addr_len;
-  delete ctx;
+  release_context(ctx);
 }
 
-void EpollServer::handle_recv_length_completion(int result, IoUringContext* ctx) {
-  if (result <= 0) {
-    SPDLOG_INFO("Client {} disconnected during length read", ctx->client_fd);
-    handle_client_disconnect(ctx->client_fd);
-    delete[] ctx->buffer;
-    delete ctx;
+void EpollServer::on_client_accepted(int client_fd) {
+  open_connection(client_fd);
+  stats_.connections_accepted++;
+  HOT_LOG_INFO("New connection: user_{}", client_fd);
+  start_client_recv(client_fd);
+}
+
+void EpollServer::handle_multishot_accept_completion(int result, unsigned flags, IoUringContext* ctx) {
+  if (result < 0) {
+    SPDLOG_ERROR("Accept failed: {}", strerror(-result));
+  } else {
+    on_client_accepted(result);
+  }
+
+  if (flags & IORING_CQE_F_MORE) {
+    return; // Still armed, keep the context for the next connection
+  }
+  if (result == -EINVAL) {
+    SPDLOG_WARN("Kernel rejected multishot accept, falling back to single-shot SQEs");
+    multishot_ = false;
+  }
+  release_context(ctx);
+  submit_accept();
+}
+
+void EpollServer::handle_multishot_recv_completion(int result, unsigned flags, IoUringContext* ctx) {
+  int client_fd = ctx->client_fd;
+  bool more = flags & IORING_CQE_F_MORE;
+
+  Connection* conn = connections_.find(client_fd);
+  bool closing = !conn || conn->closing;
+
+  if (result > 0) {
+    unsigned buffer_id = flags >> IORING_CQE_BUFFER_SHIFT;
+    stats_.recv_completions++;
+    stats_.bytes_received += result;
+    bool ok = closing ||
+              decode_client_bytes(client_fd, buf_ring_slab_.get() + size_t{buffer_id} * kBufRingBufSize,
+                                  result);
+    recycle_buffer(buffer_id);
+    if (!ok) {
+      // Stop reading from a client whose framing is broken; the cancelled recv
+      // completes with -ECANCELED and takes the disconnect path below.
+      conn->closing = true;
+      if (more) cancel_request(ctx);
+      else handle_multishot_recv_completion(-ECANCELED, 0, ctx);
+      return;
+    }
+    if (more && !closing && conn->read_pauses > 0) {
+      cancel_request(ctx); // Paused: stop the stream; the -ECANCELED completion parks it
+    } else if (!more) {
+      continue_recv(ctx); // Terminated (e.g. CQ pressure) but the socket is fine: re-arm
+    }
     return;
   }
-  
-  if (result < 20) {
-    SPDLOG_WARN("Client {} sent incomplete length prefix: {} bytes", ctx->client_fd, result);
-    handle_client_disconnect(ctx->client_fd);
-    delete[] ctx->buffer;
-    delete ctx;
+
+  if (more) {
     return;
   }
-  
-  // Parse the length
-  std::string len_str(ctx->buffer, 20);
-  int msg_length = std::atoi(len_str.c_str());
-  
-  if (msg_length <= 0 || msg_length > MAX_MESSAGE_SIZE) {
-    SPDLOG_WARN("Client {} sent invalid message length: {}", ctx->client_fd, msg_length);
-    handle_client_disconnect(ctx->client_fd);
-    delete[] ctx->buffer;
-    delete ctx;
+  if (result == -ENOBUFS) {
+    SPDLOG_WARN("Provided-buffer ring exhausted while reading client {}, re-arming", client_fd);
+    continue_recv(ctx);
     return;
   }
-  
-  SPDLOG_DEBUG("Client {} sending message of length {}", ctx->client_fd, msg_length);
-  
-  // Now read the actual message
-  submit_recv_message(ctx->client_fd, msg_length);
-  
-  delete[] ctx->buffer;
-  delete ctx;
+  if (result == -ECANCELED && !closing) {
+    continue_recv(ctx); // Cancelled for a read pause, not for teardown
+    return;
+  }
+  if (result == -EINVAL) {
+    SPDLOG_WARN("Kernel rejected multishot recv, falling back to single-shot SQEs");
+    multishot_ = false;
+    release_context(ctx);
+    submit_recv(new_recv_context(client_fd));
+    return;
+  }
+
+  HOT_LOG_INFO("Client {} disconnected during read", client_fd);
+  handle_client_disconnect(client_fd);
+  release_context(ctx);
 }
 
-void EpollServer::handle_recv_message_completion(int result, IoUringContext* ctx) {
+void EpollServer::handle_recv_completion(int result, IoUringContext* ctx) {
   if (result <= 0) {
-    SPDLOG_INFO("Client {} disconnected during message read", ctx->client_fd);
+    HOT_LOG_INFO("Client {} disconnected during read", ctx->client_fd);
     handle_client_disconnect(ctx->client_fd);
-    delete[] ctx->buffer;
-    delete ctx;
+    release_context(ctx);
     return;
   }
   
-  if (result < ctx->buffer_size) {
-    SPDLOG_WARN("Client {} sent incomplete message: {} of {} bytes", 
-                ctx->client_fd, result, ctx->buffer_size);
+  stats_.recv_completions++;
+  stats_.bytes_received += result;
+  if (!decode_client_bytes(ctx->client_fd, ctx->buffer, result)) {
     handle_client_disconnect(ctx->client_fd);
-    delete[] ctx->buffer;
-    delete ctx;
+    release_context(ctx);
     return;
   }
   
-  // Process the complete message
-  std::string msg(ctx->buffer, result);
-  SPDLOG_INFO("Received from client {}: length={} message='{}'", ctx->client_fd, result, msg);
-  parse_client_command(ctx->client_fd, msg);
-  
-  // Continue reading next message (start with length prefix)
-  submit_recv_length(ctx->client_fd);
-  
-  delete[] ctx->buffer;
-  delete ctx;
+  // Short reads are fine: whatever part of a frame arrived is carried by the decoder
+  continue_recv(ctx);
 }
 
-void EpollServer::handle_send_completion(int result, IoUringContext* ctx) {
-  if (result < 0) {
-    SPDLOG_ERROR("Send failed for client {}: {}", ctx->client_fd, strerror(-result));
-    handle_client_disconnect(ctx->client_fd);
-  } else if (result < ctx->buffer_size) {
-    SPDLOG_WARN("Incomplete send to client {}: {} of {} bytes", 
-                ctx->client_fd, result, ctx->buffer_size);
+void EpollServer::handle_log_completion(int result, IoUringContext* ctx) {
+  bool write = ctx->op_type == IO_LOG_WRITE;
+  if (write ? result != static_cast<int>(message_log_->commit_data().size()) : result < 0) {
+    log_commit_failed_ = true;
   }
-  
-  delete[] ctx->buffer;
-  delete ctx;
+  release_context(ctx);
+  if (write && message_log_->commit_needs_sync()) {
+    return;  // the linked fsync completes the batch, or reports it cancelled
+  }
+  bool ok = true;
+  if (log_commit_failed_) {
+    // Short or failed write, or a failed fsync: redo the whole batch at the same offset
+    // with blocking calls rather than leave a hole in the segment.
+    stats_.log_errors++;
+    SPDLOG_WARN("Async message log commit failed (result {}), retrying synchronously", result);
+    ok = message_log_->write_sync();
+  }
+  on_log_committed(ok);
 }
 
-void EpollServer::handle_client_disconnect(int client_fd) {
-  SPDLOG_INFO("Client {} disconnected from uring world!", client_fd);
-  
-  // Remove from channel
-  // if (auto it = client_channels_.find(client_fd); it != client_channels_.end()) {
-  //   channel_mgr_->leave_channel(it->second, client_fd);
-  //   client_channels_.erase(it);
-  // }
-  
-  // Remove username tracking
-  // if (usernames_.count(client_fd)) {
-  //   username_set_.erase(usernames_[client_fd]);
-  //   usernames_.erase(client_fd);
-  // }
-  // client_usernames_.erase(client_fd);
-  
-  // close(client_fd);
+void EpollServer::handle_send_completion(int result, IoUringContext* ctx) {
+  on_send_result(ctx, result);
+  release_context(ctx); // drops this recipient's reference to the shared frame
 }
 
-int EpollServer::send_message_uring(int client_sock, const std::string& message) {
-  submit_send(client_sock, message);
-  return message.size();
+void EpollServer::handle_send_zc_completion(int result, unsigned flags, IoUringContext* ctx) {
+  if (flags & IORING_CQE_F_NOTIF) {
+    // The kernel has released the pages; the frame may be freed now. The notification's
+    // res carries IORING_NOTIF_USAGE_ZC_COPIED when the data was copied after all.
+    if (result & (1U << 31)) {
+      stats_.zc_copied++;
+    }
+    release_context(ctx);
+    return;
+  }
+
+  // Result CQE. F_MORE means a notification follows and the buffer is still in use.
+  bool notif_pending = flags & IORING_CQE_F_MORE;
+  if (result == -EOPNOTSUPP || result == -EINVAL) {
+    // Socket or kernel cannot do zero-copy after all: stop trying and resend by copying
+    SPDLOG_WARN("Zero-copy send rejected ({}), falling back to plain sends", strerror(-result));
+    zero_copy_send_ = false;
+    stats_.zc_fallbacks++;
+    result = 0; // nothing written; the queue resubmits the same bytes
+  }
+  on_send_result(ctx, result);
+
+  if (!notif_pending) {
+    release_context(ctx);
+  }
 }
+
 #endif
 
 }
\ No newline at end of file
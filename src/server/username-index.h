@@ -0,0 +1,78 @@
+#ifndef USERNAME_INDEX_H
+#define USERNAME_INDEX_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace tt::chat::server {
+
+    // Where a named client lives: its shard, its fd there, and the conn_id that tells it
+    // apart from a later client reusing the fd.
+    struct UserLocation {
+        int shard = -1;
+        int fd = -1;
+        std::uint64_t conn_id = 0;
+    };
+
+    /**
+     * Username -> connection, for direct messages. The directory writes it alongside its
+     * own registry; senders on any shard read it without the directory lock. Names are
+     * spread over striped read-write locks, so concurrent lookups of different names
+     * rarely meet and a lookup never waits for a /join or /create.
+     */
+    class UsernameIndex {
+    public:
+        static constexpr size_t kStripes = 64;
+
+        void insert(std::string_view name, UserLocation where) {
+            Stripe& stripe = stripe_for(name);
+            std::unique_lock<std::shared_mutex> lock(stripe.mutex);
+            stripe.users.insert_or_assign(std::string(name), where);
+        }
+
+        void erase(std::string_view name) {
+            Stripe& stripe = stripe_for(name);
+            std::unique_lock<std::shared_mutex> lock(stripe.mutex);
+            if (auto it = stripe.users.find(name); it != stripe.users.end()) {
+                stripe.users.erase(it);
+            }
+        }
+
+        std::optional<UserLocation> find(std::string_view name) const {
+            const Stripe& stripe = stripe_for(name);
+            std::shared_lock<std::shared_mutex> lock(stripe.mutex);
+            auto it = stripe.users.find(name);
+            if (it == stripe.users.end()) return std::nullopt;
+            return it->second;
+        }
+
+    private:
+        // Lets find() take a string_view without building a std::string key.
+        struct NameHash {
+            using is_transparent = void;
+            size_t operator()(std::string_view name) const { return std::hash<std::string_view>{}(name); }
+        };
+
+        struct alignas(64) Stripe {
+            mutable std::shared_mutex mutex;
+            std::unordered_map<std::string, UserLocation, NameHash, std::equal_to<>> users;
+        };
+
+        Stripe& stripe_for(std::string_view name) { return stripes_[stripe_index(name)]; }
+        const Stripe& stripe_for(std::string_view name) const { return stripes_[stripe_index(name)]; }
+        // The top bits, so a stripe's map does not see only hashes that share their low bits.
+        static size_t stripe_index(std::string_view name) { return (NameHash{}(name) >> 58) % kStripes; }
+
+        Stripe stripes_[kStripes];
+    };
+
+} // namespace tt::chat::server
+
+#endif // USERNAME_INDEX_H
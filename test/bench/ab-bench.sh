@@ -0,0 +1,63 @@
+#!/usr/bin/env bash
+# A/B benchmark: runs the server once per "label=flags" variant, drives it with
+# chat_load_tester and prints the tester's throughput/latency lines next to the
+# server's own stats summary (logged when it receives SIGINT).
+#
+# Usage (from the repository root, after `make` and `make -C test`):
+#   ./test/bench/ab-bench.sh "single=--no-multishot" "multishot=--multishot"
+# Load shape is controlled with CLIENTS, MSGS, SIZE, THINK_MS and PORT. SIZE may be a
+# comma-separated list, in which case the tester sweeps it and its summary table is shown.
+# PROTO=2 makes the tester negotiate the binary v2 framing. The server's CPU time is
+# printed per variant, so bytes and CPU per message can be compared across protocols.
+# WORKLOAD picks what the clients send: channel (default), pairs (two-person channels)
+# or dm (direct messages, no channel).
+
+BIN=${BIN:-./build/server}
+LOADER=${LOADER:-./test/chat_load_tester}
+PORT=${PORT:-8080}
+CLIENTS=${CLIENTS:-50}
+MSGS=${MSGS:-200}
+SIZE=${SIZE:-64}
+THINK_MS=${THINK_MS:-0}
+CHANNEL=${CHANNEL:-testchannel}
+PROTO=${PROTO:-1}
+WORKLOAD=${WORKLOAD:-channel}
+LOADER_ARGS=${LOADER_ARGS:-}
+
+if [[ $# -eq 0 ]]; then
+    echo "Usage: $0 \"label=--server-flags\" [...]" >&2
+    exit 1
+fi
+
+mkdir -p ./profiling-data
+
+run_variant() {
+    local label=$1
+    local flags=$2
+    local log="./profiling-data/bench-${label}.log"
+
+    # shellcheck disable=SC2086
+    "$BIN" --port "$PORT" $flags > "$log" 2>&1 &
+    local pid=$!
+    sleep 2 # let the server bind before the clients connect
+
+    echo "=== ${label} (${flags:-defaults}) ==="
+    # shellcheck disable=SC2086
+    "$LOADER" 127.0.0.1 "$PORT" "$CLIENTS" "$MSGS" "$SIZE" 1 "$THINK_MS" "$CHANNEL" "$PROTO" "$WORKLOAD" $LOADER_ARGS \
+        | awk '/Size Sweep Summary/ { table = 1 } table || /Overall|Latency:|Aggregate/'
+
+    # utime + stime, in clock ticks (fields 14 and 15; the command name has no spaces)
+    local ticks
+    ticks=$(awk '{ print $14 + $15 }' "/proc/$pid/stat" 2>/dev/null)
+    kill -INT "$pid"
+    wait "$pid"
+    grep -hE "(Server|Send|Wait|Log|History|Durability|DM) stats" "$log" | sed -E 's/.*(Server|Send|Wait|Log|History|Durability|DM) stats: /server: /'
+    if [[ -n "$ticks" ]]; then
+        echo "server: cpu_ms=$(( ticks * 1000 / $(getconf CLK_TCK) ))"
+    fi
+    echo
+}
+
+for variant in "$@"; do
+    run_variant "${variant%%=*}" "${variant#*=}"
+done
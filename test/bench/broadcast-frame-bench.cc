@@ -0,0 +1,129 @@
+// Cost of turning one chat line into frames for every member of a channel, for a
+// range of channel sizes:
+//   per-recipient  the original server: "[channel] user: text" built once, then a
+//                  length-prefixed copy of it made for each member
+//   encode-once    the formatted line copied into one shared frame
+//   frame-builder  header and pieces written straight into one exactly-sized frame
+// Each member's "send" keeps a reference to (or copy of) its frame, as the outbound
+// queue would. Formatting time and allocations per broadcast should stay flat with
+// channel size for the last two; only the per-member reference count grows.
+//
+//   make bench-broadcast-frame [ROUNDS=20000]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "alloc-stats.h"
+#include "shared-frame.h"
+
+using namespace tt::chat::server;
+namespace net = tt::chat::net;
+
+namespace {
+
+const std::string kChannel = "general";
+const std::string kUser = "user_1234";
+const std::string kText = "LATENCY_TEST_MSG::SID=3::SEQ=17::TS=1234567890123::PL=XXXXXXXXXXXXXXXXXXXXXXXX";
+
+std::string format_line() {
+    std::string full_msg;
+    full_msg.reserve(kChannel.size() + kUser.size() + kText.size() + 5);
+    full_msg.append("[").append(kChannel).append("] ").append(kUser).append(": ").append(kText);
+    return full_msg;
+}
+
+struct Result {
+    double ns_per_broadcast;
+    double ns_per_recipient;
+    double allocations_per_broadcast;
+};
+
+template <typename Broadcast>
+Result run(int rounds, size_t members, Broadcast&& broadcast) {
+    std::uint64_t allocations_before = heap_allocations();
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; ++i) {
+        broadcast();
+    }
+    auto end = std::chrono::steady_clock::now();
+    double ns = std::chrono::duration<double, std::nano>(end - start).count();
+    std::uint64_t allocations = heap_allocations() - allocations_before;
+    return {ns / rounds, ns / rounds / members, static_cast<double>(allocations) / rounds};
+}
+
+void print(const char* name, const Result& r) {
+    std::cout << "  " << std::left << std::setw(15) << name << std::right << std::fixed << std::setprecision(0)
+              << std::setw(12) << r.ns_per_broadcast << " ns/broadcast" << std::setprecision(1) << std::setw(9)
+              << r.ns_per_recipient << " ns/recipient" << std::setprecision(2) << std::setw(10)
+              << r.allocations_per_broadcast << " allocations/broadcast\n";
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    int rounds = argc > 1 ? std::atoi(argv[1]) : 20000;
+    if (rounds < 1) {
+        std::cerr << "Usage: " << argv[0] << " [rounds]" << std::endl;
+        return 1;
+    }
+
+    std::uint64_t checksum = 0;
+    for (size_t members : {1, 10, 100, 1000, 10000}) {
+        // Fewer rounds for big channels, so every size takes a similar time.
+        int n = std::max(1, static_cast<int>(rounds * 10 / (members + 10)));
+        std::vector<std::string> copies;
+        std::vector<SharedFrame> refs;
+        copies.reserve(members);
+        refs.reserve(members);
+
+        Result per_recipient = run(n, members, [&] {
+            std::string full_msg = format_line();
+            copies.clear();
+            for (size_t m = 0; m < members; ++m) {
+                std::string frame(net::kLengthPrefixSize, '\0');
+                net::write_length_prefix(frame.data(), full_msg.size());
+                frame.append(full_msg);
+                copies.push_back(std::move(frame));
+            }
+            checksum += copies.back().size();
+        });
+        Result encode_once = run(n, members, [&] {
+            std::string full_msg = format_line();
+            auto frame = std::make_shared<std::string>();
+            frame->reserve(net::kLengthPrefixSize + full_msg.size());
+            frame->resize(net::kLengthPrefixSize);
+            net::write_length_prefix(frame->data(), full_msg.size());
+            frame->append(full_msg);
+            SharedFrame shared = std::move(frame);
+            refs.clear();
+            for (size_t m = 0; m < members; ++m) {
+                refs.push_back(shared);
+            }
+            checksum += refs.back()->size();
+        });
+        Result builder = run(n, members, [&] {
+            FrameBuilder body;
+            body.append("[").append(kChannel).append("] ").append(kUser).append(": ").append(kText);
+            SharedFrame shared = body.build(net::kProtocolV1, net::Opcode::kChannelMessage);
+            refs.clear();
+            for (size_t m = 0; m < members; ++m) {
+                refs.push_back(shared);
+            }
+            checksum += refs.back()->size();
+        });
+
+        std::cout << "members=" << members << " rounds=" << n << "\n";
+        print("per-recipient", per_recipient);
+        print("encode-once", encode_once);
+        print("frame-builder", builder);
+    }
+    std::cout << "checksum=" << checksum << std::endl;
+    return 0;
+}
@@ -0,0 +1,123 @@
+// Text-command parse throughput: the old split_message() + string-compare chain
+// against parse_command()'s string_view split and constexpr command table. Also counts
+// heap allocations per command, via the same operator new hook the server uses.
+//
+//   make bench-parse [OPS=5000000]
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "alloc-stats.h"
+#include "command-parser.h"
+
+using namespace tt::chat::server;
+
+namespace {
+
+// The parser the server used before, kept verbatim for comparison.
+void split_message(const std::string& msg,std::string& msg_type,std::string& msg_content){
+    size_t first_whitespace = msg.find_first_of(" \t\r\f\v\n");
+    if(first_whitespace==std::string::npos){
+      msg_type=msg;
+      msg_content="";
+      return;
+    }
+    std::string command_args=msg.substr(first_whitespace);
+    size_t first_content_character_substring=command_args.find_first_not_of(" \t\r\f\v\n");
+    size_t last_content_character_substring=command_args.find_last_not_of(" \t\r\f\v\n");
+    msg_type=msg.substr(0,first_whitespace);
+    if(first_content_character_substring==std::string::npos){
+      msg_content="";
+      return;
+    }
+    msg_content=command_args.substr(first_content_character_substring,
+                last_content_character_substring-first_content_character_substring+1);
+}
+
+Command legacy_parse(std::string_view body, size_t& arg_len) {
+    std::string msg(body);  // decode_client_bytes() copied the frame body first
+    std::string msg_type, msg_content;
+    split_message(msg, msg_type, msg_content);
+    arg_len = msg_content.size();
+    if (msg_type == "/name") return Command::kName;
+    if (msg_type == "/create") return Command::kCreate;
+    if (msg_type == "/join") return Command::kJoin;
+    if (msg_type == "/list") return Command::kList;
+    if (msg_type == "/users") return Command::kUsers;
+    if (msg_type == "/proto") return Command::kProto;
+    if (msg.rfind("/bigmsg ", 0) == 0) return Command::kBigmsg;
+    if (msg_type == "/message") return Command::kMessage;
+    return Command::kUnknown;
+}
+
+struct Result {
+    double commands_per_sec;
+    double allocations_per_command;
+    std::uint64_t checksum;
+};
+
+template <typename Parse>
+Result run(const std::vector<std::string>& corpus, int ops, Parse&& parse) {
+    std::uint64_t checksum = 0;
+    std::uint64_t allocations_before = heap_allocations();
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < ops; ++i) {
+        checksum += parse(corpus[i % corpus.size()]);
+    }
+    auto end = std::chrono::steady_clock::now();
+    std::uint64_t allocations = heap_allocations() - allocations_before;
+    double seconds = std::chrono::duration<double>(end - start).count();
+    return {ops / seconds, static_cast<double>(allocations) / ops, checksum};
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    int ops = argc > 1 ? std::atoi(argv[1]) : 5000000;
+    if (ops < 1) {
+        std::cerr << "Usage: " << argv[0] << " [ops]" << std::endl;
+        return 1;
+    }
+
+    // Mostly chat lines, as on a live server, plus the other commands.
+    std::vector<std::string> corpus = {
+        "/message hello everyone",
+        "/message LATENCY_TEST_MSG::SID=3::SEQ=17::TS=1234567890123::PL=XXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXX",
+        "/message  spaced out  ",
+        "/message ok",
+        "/join general",
+        "/name some_user",
+        "/list",
+        "/users",
+        "/create another-channel",
+        "/bogus command",
+    };
+
+    Result before = run(corpus, ops, [](const std::string& body) {
+        size_t arg_len;
+        Command command = legacy_parse(body, arg_len);
+        return static_cast<std::uint64_t>(command) + arg_len;
+    });
+    Result after = run(corpus, ops, [](const std::string& body) {
+        ParsedCommand parsed = parse_command(body);
+        return static_cast<std::uint64_t>(parsed.command) + parsed.arg.size();
+    });
+    if (before.checksum != after.checksum) {
+        std::cerr << "parsers disagree: " << before.checksum << " vs " << after.checksum << std::endl;
+        return 1;
+    }
+
+    std::cout << "ops=" << ops << " checksum=" << after.checksum << "\n" << std::fixed
+              << std::setprecision(0) << "split_message:  " << before.commands_per_sec << " commands/s, "
+              << std::setprecision(2) << before.allocations_per_command << " allocations/command\n"
+              << std::setprecision(0) << "parse_command:  " << after.commands_per_sec << " commands/s, "
+              << std::setprecision(2) << after.allocations_per_command << " allocations/command\n"
+              << "speedup:        " << after.commands_per_sec / before.commands_per_sec << "x" << std::endl;
+    return 0;
+}
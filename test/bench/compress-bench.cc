@@ -0,0 +1,109 @@
+// What negotiated compression costs and saves, per body size, on chat-like payloads
+// (log lines, JSON-ish status, and random bytes standing in for an already compressed
+// file):
+//   ratio          body bytes over compressed payload bytes (length prefix included)
+//   compress       ns to compress one body at the given zlib level, including attempts
+//                  that do not shrink it
+//   inflate        ns for a client to decode it
+// The server pays the compress column once per broadcast, however many members share
+// the frame; compressing per recipient would multiply it by the channel size.
+//
+//   make bench-compress [ROUNDS=2000] [LEVEL=1]
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <string_view>
+
+#include "compression.h"
+
+namespace net = tt::chat::net;
+
+namespace {
+
+std::string log_lines(size_t size) {
+    std::string out;
+    for (int i = 0; out.size() < size; ++i) {
+        out += "2026-03-01T12:00:" + std::to_string(10 + i % 50) + " INFO conn=" + std::to_string(1000 + i * 7) +
+               " accepted from 10.0." + std::to_string(i % 256) + ".1 latency_us=" + std::to_string(i * 37 % 900) + "\n";
+    }
+    out.resize(size);
+    return out;
+}
+
+std::string json_status(size_t size) {
+    std::string out = "[";
+    for (int i = 0; out.size() < size; ++i) {
+        out += "{\"user\":\"user_" + std::to_string(i) + "\",\"channel\":\"general\",\"online\":" +
+               (i % 3 ? "true" : "false") + ",\"seq\":" + std::to_string(i * 13) + "},";
+    }
+    out.resize(size);
+    return out;
+}
+
+std::string random_bytes(size_t size) {
+    std::mt19937 rng(42);
+    std::string out(size, '\0');
+    for (char& c : out) c = static_cast<char>(rng());
+    return out;
+}
+
+template <typename Fn>
+double ns_per_call(int rounds, Fn&& fn) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; ++i) fn();
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / rounds;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    int rounds = argc > 1 ? std::atoi(argv[1]) : 2000;
+    int level = argc > 2 ? std::atoi(argv[2]) : 1;
+    if (rounds < 1 || level < 1 || level > 9) {
+        std::cerr << "Usage: " << argv[0] << " [rounds] [level 1..9]" << std::endl;
+        return 1;
+    }
+    net::Compressor compressor(level);
+    net::Decompressor decompressor;
+    std::string compressed;
+    std::string inflated;
+
+    struct Payload {
+        const char* name;
+        std::string (*make)(size_t);
+    };
+    const Payload payloads[] = {{"log-lines", log_lines}, {"json", json_status}, {"random", random_bytes}};
+
+    std::cout << std::fixed << std::setprecision(1) << "level=" << level << "\n"
+              << std::left << std::setw(11) << "payload" << std::right << std::setw(8) << "bytes" << std::setw(8)
+              << "ratio" << std::setw(13) << "compress ns" << std::setw(12) << "inflate ns" << "\n";
+    for (const Payload& payload : payloads) {
+        for (size_t size : {256, 1024, 4096, 16384, 65536}) {
+            std::string body = payload.make(size);
+            std::string_view piece = body;
+            bool smaller = compressor.compress({&piece, 1}, compressed);
+            double compress_ns = ns_per_call(rounds, [&] { compressor.compress({&piece, 1}, compressed); });
+            double inflate_ns = 0;
+            if (smaller) {
+                compressor.compress({&piece, 1}, compressed);
+                if (!decompressor.decompress(compressed, body.size(), inflated) || inflated != body) {
+                    std::cerr << "round trip failed for " << payload.name << " " << size << std::endl;
+                    return 1;
+                }
+                inflate_ns = ns_per_call(rounds, [&] { decompressor.decompress(compressed, body.size(), inflated); });
+            }
+            std::cout << std::left << std::setw(11) << payload.name << std::right << std::setw(8) << size;
+            if (smaller) {
+                std::cout << std::setw(8) << static_cast<double>(size) / compressed.size();
+            } else {
+                std::cout << std::setw(8) << "plain";
+            }
+            std::cout << std::setw(13) << compress_ns << std::setw(12) << inflate_ns << "\n";
+        }
+    }
+    return 0;
+}
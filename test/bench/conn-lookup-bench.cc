@@ -0,0 +1,121 @@
+// Per-message lookup cost of the server's client state: the old layout (one hash map
+// per field, keyed by fd, with the channel and username copied out on every message)
+// against the fd-indexed ConnectionTable. Runs the lookups handle_channel_message()
+// and send_frame() do for one broadcast from a random client.
+//
+//   make bench-conn-table [CLIENTS=10000 OPS=5000000]
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "connection.h"
+
+using namespace tt::chat::server;
+
+namespace {
+
+struct LegacyFlow {
+    std::uint64_t conn_id;
+    bool closing = false;
+    std::deque<int> out;
+};
+
+// The maps EpollServer kept before the table, filled the same way.
+struct LegacyState {
+    std::unordered_map<int, std::string> client_usernames;
+    std::unordered_map<int, std::string> usernames;
+    std::unordered_map<int, std::string> client_channels;
+    std::unordered_map<int, LegacyFlow> flows;
+};
+
+template <typename Body>
+double time_ns_per_op(const std::vector<int>& fds, Body&& body) {
+    auto start = std::chrono::steady_clock::now();
+    for (int fd : fds) {
+        body(fd);
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count() / fds.size();
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    int clients = argc > 1 ? std::atoi(argv[1]) : 10000;
+    int ops = argc > 2 ? std::atoi(argv[2]) : 5000000;
+    if (clients < 1 || ops < 1) {
+        std::cerr << "Usage: " << argv[0] << " [clients] [ops]" << std::endl;
+        return 1;
+    }
+
+    // Clients spread over a few channels; fds start after the listening socket's, like accept().
+    std::deque<ChannelEntry> channels;
+    for (int i = 0; i < 8; ++i) channels.emplace_back(i, "channel-" + std::to_string(i));
+
+    LegacyState legacy;
+    ConnectionTable table;
+    std::vector<int> client_fds;
+    for (int i = 0; i < clients; ++i) {
+        int fd = 5 + i;
+        client_fds.push_back(fd);
+        std::string name = "user-name-" + std::to_string(i);
+        const ChannelEntry& channel = channels[i % channels.size()];
+
+        legacy.client_usernames[fd] = "user_" + std::to_string(fd);
+        legacy.usernames[fd] = name;
+        legacy.client_channels[fd] = channel.name;
+        legacy.flows.try_emplace(fd, LegacyFlow{static_cast<std::uint64_t>(i + 1), false, {}});
+
+        Connection& conn = table.open(fd, i + 1, 1024 * 1024);
+        conn.name = name;
+        conn.has_username = true;
+        conn.channel = &channels[i % channels.size()];
+    }
+
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<size_t> pick(0, client_fds.size() - 1);
+    std::vector<int> fds(ops);
+    for (int& fd : fds) fd = client_fds[pick(rng)];
+
+    // Both variants build the prefix of the broadcast line so their work is comparable;
+    // the checksum keeps the compiler from discarding it.
+    std::uint64_t sum = 0;
+    std::string line;
+    double before = time_ns_per_op(fds, [&](int fd) {
+        std::string ch = legacy.client_channels[fd];
+        std::string uname;
+        if (legacy.usernames.count(fd)) {
+            uname = legacy.usernames[fd];
+        } else {
+            uname = legacy.client_usernames[fd];
+        }
+        line.assign("[").append(ch).append("] ").append(uname).append(": ");
+        auto it = legacy.flows.find(fd);
+        if (it != legacy.flows.end() && !it->second.closing) {
+            sum += it->second.conn_id + line.size();
+        }
+    });
+
+    double after = time_ns_per_op(fds, [&](int fd) {
+        const Connection* conn = table.find(fd);
+        if (conn && conn->channel && !conn->closing) {
+            line.assign("[").append(conn->channel->name).append("] ").append(conn->name).append(": ");
+            sum += conn->conn_id + line.size();
+        }
+    });
+
+    std::cout << "clients=" << clients << " ops=" << ops << " checksum=" << sum << "\n"
+              << std::fixed << std::setprecision(1)
+              << "hash maps:        " << before << " ns/message\n"
+              << "connection table: " << after << " ns/message\n"
+              << std::setprecision(2) << "speedup:          " << before / after << "x" << std::endl;
+    return 0;
+}
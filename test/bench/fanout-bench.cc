@@ -0,0 +1,84 @@
+// Fan-out cost per recipient: walking a channel's members in the old
+// unordered_set<int> against ChannelManager's dense per-channel array. Each visit does
+// what deliver_local() does before send_frame(): skip the sender and touch the
+// recipient's per-fd state.
+//
+//   make bench-fanout [ROUNDS=200]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <unordered_set>
+#include <vector>
+
+#include "channel_manager.h"
+
+using namespace tt::chat::server;
+
+namespace {
+
+template <typename Members>
+double ns_per_recipient(const Members& members, std::vector<std::uint64_t>& per_fd, int rounds) {
+    int sender = 3;
+    auto start = std::chrono::steady_clock::now();
+    for (int round = 0; round < rounds; ++round) {
+        for (int fd : members) {
+            if (fd != sender) {
+                per_fd[fd]++;
+            }
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+    double visits = static_cast<double>(rounds) * members.size();
+    return std::chrono::duration<double, std::nano>(end - start).count() / visits;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    int rounds = argc > 1 ? std::atoi(argv[1]) : 200;
+    if (rounds < 1) {
+        std::cerr << "Usage: " << argv[0] << " [rounds]" << std::endl;
+        return 1;
+    }
+
+    std::cout << std::left << std::setw(10) << "members" << std::setw(20) << "unordered_set ns"
+              << std::setw(20) << "dense array ns" << "speedup" << std::endl;
+    for (int size : {10, 1000, 100000}) {
+        // Joins interleave with other channels' and some members leave again, so neither
+        // layout gets a freshly built, perfectly ordered container.
+        std::unordered_set<int> legacy;
+        ChannelManager manager;
+        ChannelId channel = 0;
+        ChannelId other = 1;
+        std::vector<std::uint64_t> per_fd(2 * size + 8);
+        int fd = 5;
+        for (int i = 0; i < size; ++i) {
+            legacy.insert(fd);
+            manager.join_channel(channel, fd++);
+            manager.join_channel(other, fd++);
+        }
+        for (int i = 0; i < size / 10; ++i) {
+            int leaving = 5 + 2 * (i * 7 % size);
+            legacy.erase(leaving);
+            manager.leave_channel(channel, leaving);
+            legacy.insert(leaving);
+            manager.join_channel(channel, leaving);
+        }
+
+        // Same total visits for every size.
+        int scaled_rounds = std::max(1, rounds * 100000 / size);
+        double before = ns_per_recipient(legacy, per_fd, scaled_rounds);
+        double after = ns_per_recipient(manager.members(channel), per_fd, scaled_rounds);
+
+        std::uint64_t checksum = 0;
+        for (std::uint64_t count : per_fd) checksum += count;
+        std::cout << std::left << std::setw(10) << size << std::fixed << std::setprecision(2)
+                  << std::setw(20) << before << std::setw(20) << after
+                  << before / after << "x  (checksum " << checksum << ")" << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,83 @@
+// Cold-start cost of the control plane: what a restarted server does before it
+// accepts its first client.
+//   build    CHANNELS channels, made through the normal ShardDirectory calls with the
+//            journal attached, snapshotted, then TAIL more that only reach the journal
+//   restore  a fresh directory loading the snapshot (mmap) and replaying the tail
+// The restore is repeated ROUNDS times, each into a new directory; the target is well
+// under a second for 100k channels.
+//
+//   make bench-startup [CHANNELS=100000] [TAIL=10000] [ROUNDS=5]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <spdlog/spdlog.h>
+
+#include "shard-directory.h"
+#include "state-store.h"
+
+using namespace tt::chat::server;
+
+namespace {
+
+double ms_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    int channels = argc > 1 ? std::atoi(argv[1]) : 100000;
+    int tail = argc > 2 ? std::atoi(argv[2]) : 10000;
+    int rounds = argc > 3 ? std::atoi(argv[3]) : 5;
+    if (channels < 1 || tail < 0 || rounds < 1) {
+        std::cerr << "Usage: " << argv[0] << " [channels] [tail] [rounds]" << std::endl;
+        return 1;
+    }
+    spdlog::set_level(spdlog::level::warn);
+    std::string dir = (std::filesystem::temp_directory_path() / "chat-startup-bench").string();
+    std::filesystem::remove_all(dir);
+
+    {
+        ShardDirectory directory;
+        StateStore store(dir, directory);
+        store.restore();
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < channels; ++i) {
+            directory.create_channel("channel-" + std::to_string(i));
+        }
+        double build_ms = ms_since(start);
+        start = std::chrono::steady_clock::now();
+        store.snapshot();
+        double snapshot_ms = ms_since(start);
+        for (int i = 0; i < tail; ++i) {
+            directory.create_channel("late-channel-" + std::to_string(i));
+        }
+        std::cout << std::fixed << std::setprecision(1) << "channels=" << channels << " tail=" << tail
+                  << "\n  build      " << std::setw(9) << build_ms << " ms (journaled)"
+                  << "\n  snapshot   " << std::setw(9) << snapshot_ms << " ms, "
+                  << std::filesystem::file_size(dir + "/state.snap") << " bytes\n";
+    }
+
+    std::vector<double> times;
+    StateStore::RestoreStats stats;
+    for (int r = 0; r < rounds; ++r) {
+        ShardDirectory directory;
+        StateStore store(dir, directory);
+        auto start = std::chrono::steady_clock::now();
+        stats = store.restore();
+        times.push_back(ms_since(start));
+    }
+    std::sort(times.begin(), times.end());
+    std::cout << "  restore    " << std::setw(9) << times[times.size() / 2] << " ms median, "
+              << times.front() << " ms best (channels=" << stats.channels
+              << " journal_records=" << stats.journal_records << ")\n";
+    std::filesystem::remove_all(dir);
+    return 0;
+}
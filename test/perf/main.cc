@@ -9,57 +9,47 @@
 #include <algorithm>
 void print_usage(const char* prog_name) {
     std::cerr << "Usage: " << prog_name << " <server_ip> <server_port> <num_clients> "
-              << "<messages_per_client> <message_size_bytes> [listen_replies (0 or 1)] [think_time_ms (0+)] [channel_name]" << std::endl;
+              << "<messages_per_client> <message_size_bytes> [listen_replies (0 or 1)] [think_time_ms (0+)] [channel_name] [protocol (1 or 2)] "
+              << "[workload (channel, pairs or dm)]" << std::endl;
     std::cerr << "Example: " << prog_name << " 127.0.0.1 8080 10 100 64 1 10 testchannel" << std::endl;
+    std::cerr << "Size sweep: pass a comma-separated list of sizes, e.g. 64,4096,65536,1048576. "
+              << "The scenario runs once per size and a summary table is printed at the end." << std::endl;
+    std::cerr << "Workloads: channel = everyone broadcasts on one channel; pairs = two-person channels; "
+              << "dm = /dm to every other client in turn, no channel." << std::endl;
 }
 
-int main(int argc, char* argv[]) {
-    if (argc < 6) {
-        print_usage(argv[0]);
-        return 1;
-    }
-
-    std::string server_ip = argv[1];
-    int server_port = 0;
-    int num_clients = 0;
-    int messages_per_client = 0; // Can be 0 if only listening
+// Headline numbers of one scenario run, used for the size-sweep table.
+struct ScenarioSummary {
     int message_size_bytes = 0;
-    bool listen_replies = false;
-    int think_time_ms = 0;
-    std::string channel_name = "testchannel"; // Default common channel
+    double send_mps = 0;
+    double recv_mps = 0;
+    double recv_mb_per_sec = 0;
+    double median_latency_ms = 0;
+    double p99_latency_ms = 0;
+};
 
-    try {
-        server_port = std::stoi(argv[2]);
-        num_clients = std::stoi(argv[3]);
-        messages_per_client = std::stoi(argv[4]);
-        message_size_bytes = std::stoi(argv[5]); // Must be > 0 if messages_per_client > 0
-        if (argc > 6) listen_replies = (std::stoi(argv[6]) == 1);
-        if (argc > 7) think_time_ms = std::stoi(argv[7]);
-        if (argc > 8) channel_name = argv[8];
-    } catch (const std::exception& e) {
-        std::cerr << "Error parsing arguments: " << e.what() << std::endl;
-        print_usage(argv[0]);
-        return 1;
-    }
+ScenarioSummary run_scenario(const std::string& server_ip, int server_port, int num_clients,
+                             int messages_per_client, int message_size_bytes, bool listen_replies,
+                             int think_time_ms, const std::string& channel_name, int protocol,
+                             tt::chat::test::Workload workload) {
+    ScenarioSummary summary;
+    summary.message_size_bytes = message_size_bytes;
 
-    if (num_clients <= 0 || (messages_per_client > 0 && message_size_bytes <= 0)) {
-        std::cerr << "Error: Num clients must be > 0. If sending messages, message size must be > 0." << std::endl;
-        return 1;
-    }
-    if (think_time_ms < 0) think_time_ms = 0;
 
     int total_test_clients_for_wrapper = num_clients; 
 
 
     std::vector<std::unique_ptr<tt::chat::test::TestClient>> clients_wrappers;
     std::vector<std::thread> client_threads;
+    std::atomic<int> clients_ready{0};
 
     auto overall_start_time = std::chrono::steady_clock::now();
 
     for (int i = 0; i < num_clients; ++i) {
         clients_wrappers.emplace_back(std::make_unique<tt::chat::test::TestClient>(
             i, server_ip, server_port, messages_per_client, message_size_bytes,
-            listen_replies, think_time_ms, channel_name, total_test_clients_for_wrapper
+            listen_replies, think_time_ms, channel_name, total_test_clients_for_wrapper, protocol,
+            workload, workload == tt::chat::test::Workload::kDm ? &clients_ready : nullptr
         ));
     }
     
@@ -133,12 +123,15 @@ int main(int argc, char* argv[]) {
     if (total_test_duration.count() > 0.001 && total_messages_sent_agg > 0) {
         double overall_send_mps = static_cast<double>(total_messages_sent_agg) / total_test_duration.count();
         double overall_send_Bps = static_cast<double>(total_bytes_sent_agg) / total_test_duration.count();
+        summary.send_mps = overall_send_mps;
         std::cout << "Overall Send Rate (across all clients, wall clock): " << overall_send_mps << " msgs/sec" << std::endl;
         std::cout << "Overall Send Data Rate: " << overall_send_Bps / 1024.0 << " KB/s" << std::endl;
     }
     if (listen_replies && total_test_duration.count() > 0.001 && total_messages_received_agg > 0) {
         double overall_recv_mps = static_cast<double>(total_messages_received_agg) / total_test_duration.count();
         double overall_recv_Bps = static_cast<double>(total_bytes_received_agg) / total_test_duration.count();
+        summary.recv_mps = overall_recv_mps;
+        summary.recv_mb_per_sec = overall_recv_Bps / (1024 * 1024);
         std::cout << "Overall Receive Rate (across all clients, wall clock): " << overall_recv_mps << " msgs/sec" << std::endl;
         std::cout << "Overall Receive Data Rate: " << overall_recv_Bps / 1024.0 << " KB/s" << std::endl;
     }
@@ -190,6 +183,9 @@ if (listen_replies && !all_latencies_collected_ns.empty()) {
                                                                   all_latencies_collected_ns.size()-1))]).count();}
 
 
+        summary.median_latency_ms = median_latency_ns / 1e6;
+        summary.p99_latency_ms = p99_latency_ns / 1e6;
+
         std::cout << std::fixed << std::setprecision(5); // For ms output
         std::cout << "Min Latency:    " << min_latency_ns / 1e6 << " ms (" << min_latency_ns << " ns)" << std::endl;
         std::cout << "Avg Latency:    " << avg_latency_ms << " ms (" << avg_latency_ns << " ns)" << std::endl;
@@ -205,8 +201,86 @@ if (listen_replies && !all_latencies_collected_ns.empty()) {
 
     std::cout << "--------------------------------------------------------" << std::endl;
 
-    return 0;
+    return summary;
 }
 
+int main(int argc, char* argv[]) {
+    if (argc < 6) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    std::string server_ip = argv[1];
+    int server_port = 0;
+    int num_clients = 0;
+    int messages_per_client = 0; // Can be 0 if only listening
+    std::vector<int> message_sizes;
+    bool listen_replies = false;
+    int think_time_ms = 0;
+    std::string channel_name = "testchannel"; // Default common channel
+    int protocol = 1;
+    tt::chat::test::Workload workload = tt::chat::test::Workload::kChannel;
+
+    try {
+        server_port = std::stoi(argv[2]);
+        num_clients = std::stoi(argv[3]);
+        messages_per_client = std::stoi(argv[4]);
+        // Must be > 0 if messages_per_client > 0; a comma-separated list selects a size sweep
+        std::string sizes_arg = argv[5];
+        for (size_t start = 0; start <= sizes_arg.size();) {
+            size_t comma = std::min(sizes_arg.find(',', start), sizes_arg.size());
+            message_sizes.push_back(std::stoi(sizes_arg.substr(start, comma - start)));
+            start = comma + 1;
+        }
+        if (argc > 6) listen_replies = (std::stoi(argv[6]) == 1);
+        if (argc > 7) think_time_ms = std::stoi(argv[7]);
+        if (argc > 8) channel_name = argv[8];
+        if (argc > 9) protocol = std::stoi(argv[9]);
+        if (argc > 10) {
+            std::string name = argv[10];
+            if (name == "pairs") workload = tt::chat::test::Workload::kPairs;
+            else if (name == "dm") workload = tt::chat::test::Workload::kDm;
+            else if (name != "channel") throw std::invalid_argument("unknown workload " + name);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error parsing arguments: " << e.what() << std::endl;
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    bool bad_size = std::any_of(message_sizes.begin(), message_sizes.end(), [](int s) { return s <= 0; });
+    if (num_clients <= 0 || (messages_per_client > 0 && bad_size)) {
+        std::cerr << "Error: Num clients must be > 0. If sending messages, message size must be > 0." << std::endl;
+        return 1;
+    }
+    if (think_time_ms < 0) think_time_ms = 0;
+
 
-  
\ No newline at end of file
+    if (message_sizes.size() == 1) {
+        run_scenario(server_ip, server_port, num_clients, messages_per_client, message_sizes[0],
+                     listen_replies, think_time_ms, channel_name, protocol, workload);
+        return 0;
+    }
+
+    std::vector<ScenarioSummary> sweep;
+    for (int size : message_sizes) {
+        std::cout << "\n================ Message size " << size << " bytes ================" << std::endl;
+        // A fresh channel per step, so each run starts from a clean member list
+        sweep.push_back(run_scenario(server_ip, server_port, num_clients, messages_per_client, size,
+                                     listen_replies, think_time_ms,
+                                     channel_name + "_" + std::to_string(size), protocol, workload));
+        std::this_thread::sleep_for(std::chrono::milliseconds(500)); // let the server reap disconnects
+    }
+
+    std::cout << "\n================ Size Sweep Summary ================" << std::endl;
+    std::cout << std::left << std::setw(12) << "size(B)" << std::setw(14) << "send msg/s"
+              << std::setw(14) << "recv msg/s" << std::setw(12) << "recv MB/s"
+              << std::setw(14) << "median(ms)" << std::setw(12) << "p99(ms)" << std::endl;
+    std::cout << std::fixed << std::setprecision(3);
+    for (const auto& s : sweep) {
+        std::cout << std::left << std::setw(12) << s.message_size_bytes << std::setw(14) << s.send_mps
+                  << std::setw(14) << s.recv_mps << std::setw(12) << s.recv_mb_per_sec
+                  << std::setw(14) << s.median_latency_ms << std::setw(12) << s.p99_latency_ms << std::endl;
+    }
+    return 0;
+}
@@ -82,7 +82,8 @@ bool TestClient::parse_test_message(const std::string& msg_str,
 
 
 TestClient::TestClient(int id, const std::string& server_ip, int server_port, int num_messages_to_send, int message_size_bytes,
-    bool listen_for_replies, int client_think_time_ms, const std::string& common_channel_name, int total_test_clients)
+    bool listen_for_replies, int client_think_time_ms, const std::string& common_channel_name, int total_test_clients,
+    int protocol_version, Workload workload, std::atomic<int>* clients_ready)
 
 
     : client_id_(id),
@@ -93,7 +94,15 @@ TestClient::TestClient(int id, const std::string& server_ip, int server_port, in
       listen_for_replies_param_(listen_for_replies),
       client_think_time_ms_param_(client_think_time_ms),
       common_channel_name_param_(common_channel_name),
-      total_test_clients_param_(total_test_clients) {
+      total_test_clients_param_(total_test_clients),
+      protocol_version_param_(protocol_version),
+      workload_param_(workload),
+      clients_ready_(clients_ready) {
+    if (workload_param_ == Workload::kDm) {
+        common_channel_name_param_.clear(); // names only
+    } else if (workload_param_ == Workload::kPairs) {
+        common_channel_name_param_ += "_pair_" + std::to_string(client_id_ / 2);
+    }
 
     stats_.client_id = id;
     // LOG_TEST_INFO(client_id_, "Constructed. Payload size: " << message_size_bytes_param_);
@@ -123,6 +132,10 @@ bool TestClient::initialize_and_connect_() {
             server_port_param_, server_ip_param_
         );
         stats_.connection_successful = true;
+        if (protocol_version_param_ == 2 && !actual_client_->negotiate_protocol_v2()) {
+            stats_.error_message = "Server rejected protocol 2";
+            stats_.connection_successful = false;
+        }
         // LOG_TEST_INFO(client_id_, "Connection successful.");
     } catch (const std::runtime_error& e) {
         stats_.error_message = "Connection failed: " + std::string(e.what());
@@ -170,8 +183,9 @@ void TestClient::perform_initial_setup_() {
         std::string name_cmd = "/name TestUser" + std::to_string(client_id_);
         actual_client_->send_message(name_cmd);
         std::this_thread::sleep_for(std::chrono::milliseconds(20)); // Small delay
-        // 2. Join a common channel
+        // 2. Join a common channel, once client 0 has had time to create it
         if (!common_channel_name_param_.empty()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
             std::string join_cmd = "/join " + common_channel_name_param_;
             actual_client_->send_message(join_cmd);
             std::this_thread::sleep_for(std::chrono::milliseconds(20)); // Small delay
@@ -182,6 +196,21 @@ void TestClient::perform_initial_setup_() {
         keep_running_ = false; // Stop the test if setup fails
     }
 }
+void TestClient::wait_for_peers_() {
+    if (!clients_ready_) return;
+    clients_ready_->fetch_add(1);
+    while (clients_ready_->load() < total_test_clients_param_) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+}
+
+std::string TestClient::next_dm_target_(int msg_seq) const {
+    // Every other client in turn, so each one receives about as many as it sends.
+    int others = total_test_clients_param_ - 1;
+    int peer = others > 0 ? (client_id_ + 1 + msg_seq % others) % total_test_clients_param_ : client_id_;
+    return "@TestUser" + std::to_string(peer);
+}
+
 void TestClient::execute_send_phase_() {
     if (!stats_.connection_successful || !actual_client_ || !keep_running_) return;
 
@@ -190,12 +219,15 @@ void TestClient::execute_send_phase_() {
 
     for (int i = 0; i < num_messages_to_send_param_ && keep_running_; ++i) {
         auto send_timestamp = std::chrono::steady_clock::now();
-        std::string message_to_send = format_test_message(client_id_, i, send_timestamp, message_size_bytes_param_);
+        // A channel message the server fans out to the other test clients, or a DM to one
+        std::string message_to_send = workload_param_ == Workload::kDm
+            ? "/dm " + next_dm_target_(i) + " " + format_test_message(client_id_, i, send_timestamp, message_size_bytes_param_)
+            : "/message " + format_test_message(client_id_, i, send_timestamp, message_size_bytes_param_);
 
         try {
-            actual_client_->send_message(message_to_send);
+            // Bytes on the wire, framing included, so v1 and v2 runs compare directly.
+            stats_.bytes_sent += actual_client_->send_message(message_to_send);
             stats_.messages_sent++;
-            stats_.bytes_sent += message_to_send.length();
         } catch (const std::runtime_error& e) {
             // ... (error handling) ...
             stats_.error_message = "Send phase: Send failed on message " + std::to_string(i) + ": " + std::string(e.what());
@@ -242,8 +274,8 @@ void TestClient::execute_listen_phase_() {
 
             // stats_.messages_received++;
             stats_.bytes_received += bytes_read;
-            buffer[bytes_read] = '\0'; // Null-terminate the received chunk
-            partial_message_buffer += buffer; // Append to any previous partial message
+            // Appended by length: v2 headers contain NUL bytes
+            partial_message_buffer.append(buffer, bytes_read);
 
             size_t msg_start_pos = 0;
             size_t msg_end_pos = 0;
@@ -346,15 +378,19 @@ void TestClient::run_test() {
 
     if (!initialize_and_connect_()) {
         keep_running_ = false; 
+        wait_for_peers_(); // still counted, or the others would wait forever
         stats_.total_run_duration = std::chrono::steady_clock::now() - scenario_start_time;
         return; // Cannot proceed if connection failed
     }
     //for the first client, create the channel such that all clients can join it
-    if (client_id_ == 0 && !common_channel_name_param_.empty()) {
+    // (with pairs, the first client of each pair creates theirs)
+    int creator_id = workload_param_ == Workload::kPairs ? client_id_ % 2 : client_id_;
+    if (creator_id == 0 && !common_channel_name_param_.empty()) {
         perform_initial_setup_0_();
     } else {
         perform_initial_setup_();
     }
+    wait_for_peers_();
     if (!keep_running_) { // If initial setup failed
          stats_.total_run_duration = std::chrono::steady_clock::now() - scenario_start_time;
          return;
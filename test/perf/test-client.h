@@ -4,12 +4,19 @@
 #include <string>
 #include <chrono>
 #include <atomic> 
+#include <vector>
 
 #include "../../src/client/chat-client.h"
 #include <memory> 
 #include <thread>
 namespace tt::chat::test {
 
+// What each client sends:
+//   kChannel  every client joins one common channel and broadcasts to it
+//   kPairs    clients 2k and 2k+1 share a two-person channel, the old way to fake a DM
+//   kDm       no channel; every message is a /dm to another test client, round robin
+enum class Workload { kChannel, kPairs, kDm };
+
 struct TestClientStats {
     long long messages_sent = 0;
     long long messages_received = 0;
@@ -32,7 +39,9 @@ public:
                       const std::string& server_ip, int server_port,
                       int num_messages_to_send, int message_size_bytes,
                       bool listen_for_replies, int client_think_time_ms,
-                      const std::string& common_channel_name, int total_test_clients);
+                      const std::string& common_channel_name, int total_test_clients,
+                      int protocol_version = 1, Workload workload = Workload::kChannel,
+                      std::atomic<int>* clients_ready = nullptr);
     ~TestClient();
 
     TestClient(const TestClient&) = delete;
@@ -59,6 +68,10 @@ private:
     std::string common_channel_name_param_;
 
     int total_test_clients_param_; // To distinguish test messages
+    int protocol_version_param_;   // 2: negotiate binary framing right after connecting
+    Workload workload_param_;
+    // Shared by all clients of a DM run: nobody sends until every client has a name.
+    std::atomic<int>* clients_ready_;
 
 
 
@@ -71,6 +84,8 @@ private:
     bool initialize_and_connect_();
     void perform_initial_setup_();  // Sets name, creates and joins channel
     void perform_initial_setup_0_();
+    void wait_for_peers_();
+    std::string next_dm_target_(int msg_seq) const;
     void execute_send_phase_();
     void execute_listen_phase_(); 
 